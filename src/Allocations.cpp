@@ -0,0 +1,72 @@
+#include "Allocations.h"
+
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// replacements for the global allocation functions that count calls per
+// thread; everything else is plain malloc / free
+
+static thread_local uint64_t allocations = 0;
+
+uint64_t threadAllocations() {
+  return allocations;
+}
+
+static void * allocate(std::size_t n) {
+  allocations++;
+  void * p = std::malloc(n ? n : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+static void * allocateAligned(std::size_t n, std::align_val_t al) {
+  allocations++;
+  std::size_t a = static_cast<std::size_t>(al);
+#ifdef _WIN32
+  // (no aligned_alloc there; these need _aligned_free rather than free)
+  void * p = _aligned_malloc(n ? n : 1, a);
+#else
+  void * p = std::aligned_alloc(a, (n + a - 1) / a * a);
+#endif
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+static void freeAligned(void * p) {
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+
+void * operator new(std::size_t n) { return allocate(n); }
+void * operator new[](std::size_t n) { return allocate(n); }
+void * operator new(std::size_t n, std::align_val_t al) { return allocateAligned(n, al); }
+void * operator new[](std::size_t n, std::align_val_t al) { return allocateAligned(n, al); }
+
+void * operator new(std::size_t n, const std::nothrow_t &) noexcept {
+  try { return allocate(n); } catch (...) { return nullptr; }
+}
+void * operator new[](std::size_t n, const std::nothrow_t &) noexcept {
+  try { return allocate(n); } catch (...) { return nullptr; }
+}
+
+void operator delete(void * p) noexcept { std::free(p); }
+void operator delete[](void * p) noexcept { std::free(p); }
+void operator delete(void * p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void * p, std::size_t) noexcept { std::free(p); }
+void operator delete(void * p, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete[](void * p, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete(void * p, std::size_t, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete[](void * p, std::size_t, std::align_val_t) noexcept { freeAligned(p); }
+void operator delete(void * p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void * p, const std::nothrow_t &) noexcept { std::free(p); }
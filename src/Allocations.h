@@ -0,0 +1,12 @@
+#ifndef __ALLOCATIONS_H__
+#define __ALLOCATIONS_H__
+
+#include <cstdint>
+
+/** Number of times the calling thread has called the global operator new
+  * (any form). Used to check that the search loop doesn't allocate once
+  * it's warmed up.
+  */
+uint64_t threadAllocations();
+
+#endif
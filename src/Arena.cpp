@@ -0,0 +1,37 @@
+#include "Arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+Arena::Arena(size_t chunkSize) : _chunkSize(chunkSize), _current(0), _used(0) {
+}
+
+size_t Arena::capacity() const {
+  size_t ret = 0;
+  for (const Chunk & c : _chunks) {
+    ret += c.size;
+  }
+  return ret;
+}
+
+void * Arena::do_allocate(size_t bytes, size_t alignment) {
+  while (_current < _chunks.size()) {
+    Chunk & c = _chunks[_current];
+    uintptr_t base = reinterpret_cast<uintptr_t>(c.data.get());
+    size_t offset = ((base + _used + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+    if (offset + bytes <= c.size) {
+      _used = offset + bytes;
+      return c.data.get() + offset;
+    }
+    // the rest of this chunk is wasted until the next reset()
+    _current++;
+    _used = 0;
+  }
+
+  // (only ever while warming up: the chunks stay for later steps)
+  size_t size = std::max(_chunkSize, bytes + alignment);
+  _chunks.push_back({std::unique_ptr<char[]>(new char[size]), size});
+  _current = _chunks.size() - 1;
+  _used = 0;
+  return do_allocate(bytes, alignment);
+}
@@ -0,0 +1,55 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+/** Bump allocator for short lived temporaries, as a std::pmr resource (so
+  * std::pmr containers can use it): allocation advances a pointer through
+  * the current chunk, deallocation does nothing, and reset() frees
+  * everything at once.
+  *
+  * Chunks are kept across reset(), so once an arena has grown to what a
+  * search step needs, later steps don't touch the global heap at all.
+  *
+  * @note not thread safe; one per thread.
+  */
+class Arena : public std::pmr::memory_resource {
+public:
+  explicit Arena(size_t chunkSize = 64 * 1024);
+
+  Arena(const Arena &) = delete;
+  Arena & operator=(const Arena &) = delete;
+
+  /** Forget everything allocated so far (without running destructors). */
+  inline void reset() {
+    _current = 0;
+    _used = 0;
+  }
+
+  /** Bytes in all chunks. */
+  size_t capacity() const;
+
+protected:
+  void * do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void *, size_t, size_t) override {}
+  bool do_is_equal(const std::pmr::memory_resource & other) const noexcept override {
+    return this == &other;
+  }
+
+private:
+  struct Chunk {
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+
+  size_t _chunkSize;
+  std::vector<Chunk> _chunks;
+  // chunk being allocated from, and how much of it is taken
+  size_t _current;
+  size_t _used;
+};
+
+#endif
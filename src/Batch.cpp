@@ -0,0 +1,256 @@
+#include "Batch.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+std::string Job::name() const {
+  std::string ret = std::to_string(x) + "x" + std::to_string(y) + "x" + std::to_string(z)
+    + "-" + fuelNameForFuelType(fuel) + "-" + strategyName(strategy);
+  if (coolerRestrictions != 1) {
+    ret += "-c" + std::to_string(coolerRestrictions);
+  }
+  return ret;
+}
+
+/** Expand "1,3-5" into {1, 3, 4, 5}; `parse` turns one item into a number
+  * (or -1).
+  */
+static bool expandField(const std::string & field, std::function<int(const std::string &)> parse, std::vector<int> & out) {
+  std::stringstream ss(field);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    size_t dash = item.find('-', 1);
+    int from = parse(dash == std::string::npos ? item : item.substr(0, dash));
+    int to = dash == std::string::npos ? from : parse(item.substr(dash + 1));
+    if (from < 0 || to < from) {
+      return false;
+    }
+    for (int v = from; v <= to; v++) {
+      out.push_back(v);
+    }
+  }
+  return !out.empty();
+}
+
+static int parseNumber(const std::string & s) {
+  char * end;
+  long v = strtol(s.c_str(), &end, 10);
+  return s.empty() || *end ? -1 : (int)v;
+}
+
+static int parseFuel(const std::string & s) {
+  FuelType f;
+  return fuelTypeForName(s, f) && static_cast<int>(f) >= 2 ? static_cast<int>(f) : -1;
+}
+
+bool readJobFile(const std::string & fn, std::vector<Job> & jobs) {
+  std::ifstream in(fn);
+  if (!in) {
+    fprintf(stderr, "couldn't open job file %s\n", fn.c_str());
+    return false;
+  }
+
+  std::string line;
+  int lineNo = 0;
+  while (std::getline(in, line)) {
+    lineNo++;
+    line = line.substr(0, line.find('#'));
+
+    std::stringstream ss(line);
+    std::vector<std::string> fields;
+    std::string field;
+    while (ss >> field) {
+      fields.push_back(field);
+    }
+
+    if (fields.empty()) {
+      continue;
+    }
+
+    std::vector<int> xs, ys, zs, fuels, strategies, restrictions;
+    bool ok = (fields.size() == 5 || fields.size() == 6)
+      && expandField(fields[0], parseNumber, xs)
+      && expandField(fields[1], parseNumber, ys)
+      && expandField(fields[2], parseNumber, zs)
+      && expandField(fields[3], parseFuel, fuels)
+      && expandField(fields[4], parseNumber, strategies)
+      && expandField(fields.size() == 6 ? fields[5] : "1", parseNumber, restrictions);
+
+    for (int x : xs)
+      for (int y : ys)
+        for (int z : zs)
+          ok &= Reactor::validDimensions(x, y, z);
+    for (int v : strategies) ok &= objectiveForStrategy(v) != nullptr;
+    for (int v : restrictions) ok &= v <= 2;
+
+    if (!ok) {
+      fprintf(stderr, "%s:%d: expected x y z fuelType strategy [coolerRestrictions]\n", fn.c_str(), lineNo);
+      return false;
+    }
+
+    for (int x : xs)
+      for (int y : ys)
+        for (int z : zs)
+          for (int f : fuels)
+            for (int s : strategies)
+              for (int c : restrictions)
+                jobs.push_back({(index_t)x, (index_t)y, (index_t)z, static_cast<FuelType>(f), s, c});
+  }
+
+  return true;
+}
+
+int threadsForJob(const Job & job, int cores) {
+  long volume = (long)job.x * job.y * job.z;
+  return (int)std::clamp(volume / 27, 1L, (long)std::max(cores, 1));
+}
+
+struct JobResult {
+  bool done = false;
+  int threads = 0;
+  long steps = 0;
+  double seconds = 0;
+  int cells = 0;
+  float effectivePower = 0;
+  float metric = 0;
+  float gap = 0;
+  int inactive = 0;
+};
+
+void runJobs(const std::vector<Job> & jobs, const SearchOptions & base, std::function<void(StopPolicy &)> adjustStop, int cores, const std::string & outDir) {
+  cores = std::max(cores, 1);
+
+  std::error_code ec;
+  std::filesystem::create_directories(outDir, ec);
+  if (ec) {
+    fprintf(stderr, "couldn't create %s: %s\n", outDir.c_str(), ec.message().c_str());
+    return;
+  }
+
+  std::vector<JobResult> results(jobs.size());
+
+  // largest first, so the long jobs don't end up running last
+  std::vector<size_t> pending(jobs.size());
+  for (size_t i = 0; i < jobs.size(); i++) {
+    pending[i] = i;
+  }
+  std::stable_sort(pending.begin(), pending.end(), [&](size_t a, size_t b) {
+    return (long)jobs[a].x * jobs[a].y * jobs[a].z > (long)jobs[b].x * jobs[b].y * jobs[b].z;
+  });
+
+  std::mutex mutex;
+  std::condition_variable finished;
+  int freeThreads = cores;
+  int running = 0;
+
+  auto runJob = [&](size_t i, int threads) {
+    const Job & job = jobs[i];
+
+    SearchOptions options = base;
+    options.fuel = job.fuel;
+    options.objective = objectiveForStrategy(job.strategy);
+    options.coolerRestrictions = job.coolerRestrictions;
+    options.threads = threads;
+    options.logEvery = 0;
+    options.checkpointPath = "";
+    options.onNewBest = nullptr;
+    options.snapshotRequested = nullptr;
+    options.stop = StopPolicy::forDimensions(job.x, job.y, job.z);
+    if (adjustStop) {
+      adjustStop(options.stop);
+    }
+
+    Search search(Reactor(job.x, job.y, job.z), options);
+    search.run();
+
+    Reactor & best = search.best();
+    best.toJsonFile(outDir + "/" + job.name() + ".json");
+
+    JobResult & res = results[i];
+    res.threads = threads;
+    res.steps = search.steps();
+    res.seconds = search.monitor().elapsedSeconds();
+    res.cells = best.totalCells();
+    res.effectivePower = best.effectivePowerGenerated(job.fuel);
+    res.metric = objectiveMetric(best, job.fuel, options.objective);
+    res.gap = search.gap(best);
+    res.inactive = best.inactiveBlocks();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      res.done = true;
+      freeThreads += threads;
+      running--;
+      fprintf(stderr, "done %s: %d threads, %ld steps, %.1fs, effective output %f, gap %.2f%%\n",
+        job.name().c_str(), threads, res.steps, res.seconds, res.effectivePower, 100 * res.gap);
+    }
+    finished.notify_one();
+  };
+
+  std::vector<std::thread> workers;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!pending.empty()) {
+      // the largest pending job that fits in the free threads
+      auto next = std::find_if(pending.begin(), pending.end(), [&](size_t i) {
+        return threadsForJob(jobs[i], cores) <= freeThreads;
+      });
+
+      if (base.interrupted && *base.interrupted) {
+        break;
+      }
+
+      if (next == pending.end()) {
+        finished.wait(lock);
+        continue;
+      }
+
+      size_t i = *next;
+      pending.erase(next);
+      int threads = threadsForJob(jobs[i], cores);
+      freeThreads -= threads;
+      running++;
+      fprintf(stderr, "start %s: %d threads (%d jobs running, %zu pending)\n", jobs[i].name().c_str(), threads, running, pending.size());
+      workers.emplace_back(runJob, i, threads);
+    }
+  }
+
+  for (std::thread & t : workers) {
+    t.join();
+  }
+
+  std::string summaryFn = outDir + "/summary.tsv";
+  FILE * summary = fopen(summaryFn.c_str(), "w");
+  if (!summary) {
+    fprintf(stderr, "couldn't write %s\n", summaryFn.c_str());
+  }
+
+  auto row = [&](const char * fmt, auto... args) {
+    printf(fmt, args...);
+    if (summary) fprintf(summary, fmt, args...);
+  };
+
+  row("x\ty\tz\tfuel\tstrategy\tcoolers\tthreads\tsteps\tseconds\tcells\tinactive\teffectiveOutput\tmetric\tgap\tfile\n");
+  for (size_t i = 0; i < jobs.size(); i++) {
+    const Job & job = jobs[i];
+    const JobResult & res = results[i];
+    if (!res.done) {
+      continue;
+    }
+    row("%d\t%d\t%d\t%s\t%s\t%d\t%d\t%ld\t%.2f\t%d\t%d\t%f\t%f\t%.4f\t%s\n",
+      job.x, job.y, job.z, fuelNameForFuelType(job.fuel).c_str(), strategyName(job.strategy), job.coolerRestrictions,
+      res.threads, res.steps, res.seconds, res.cells, res.inactive, res.effectivePower, res.metric, res.gap,
+      (job.name() + ".json").c_str());
+  }
+
+  if (summary) {
+    fclose(summary);
+  }
+}
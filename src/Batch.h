@@ -0,0 +1,52 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "Reactor.h"
+#include "Search.h"
+
+/** One problem instance of a batch. */
+struct Job {
+  index_t x, y, z;
+  FuelType fuel;
+  // as on the command line: 0: efficiency, 1: output, 2: cells
+  int strategy;
+  int coolerRestrictions;
+
+  /** e.g. "5x5x5-LEU235O-efficiency" */
+  std::string name() const;
+};
+
+/** Read a job file. Every line is
+  *
+  *     x y z fuelType strategy [coolerRestrictions]
+  *
+  * where each field may also be a comma separated list and / or an a-b
+  * range (fuels by number or name), and stands for every combination:
+  *
+  *     3-5 3-5 5 LEU235O,HEU235O 0,1
+  *
+  * Blank lines and anything after a # are ignored.
+  *
+  * @return false (with a message on stderr) on a malformed line
+  */
+bool readJobFile(const std::string & fn, std::vector<Job> & jobs);
+
+/** Threads a job gets: one per 27 cells (a 3x3x3), up to `cores`. */
+int threadsForJob(const Job & job, int cores);
+
+/** Run every job, sharing `cores` threads between them: jobs are started
+  * largest first whenever enough threads are free, smaller ones fill in the
+  * gaps. Each best reactor goes to `outDir`/<name>.json, and a summary
+  * table to `outDir`/summary.tsv (and stdout).
+  *
+  * `base` supplies everything but dimensions, fuel, strategy, cooler
+  * restrictions and threads. Each job's stop policy is
+  * StopPolicy::forDimensions, then passed through `adjustStop` if given.
+  */
+void runJobs(const std::vector<Job> & jobs, const SearchOptions & base, std::function<void(StopPolicy &)> adjustStop, int cores, const std::string & outDir);
+
+#endif
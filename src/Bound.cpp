@@ -0,0 +1,41 @@
+#include "Bound.h"
+
+#include <algorithm>
+
+ScoreBound scoreBound(index_t x, index_t y, index_t z, FuelType ft) {
+  ScoreBound ret = { 0, 0, 0 };
+
+  const float volume = (float)x * y * z;
+  const float power = fuelPowerForFuelType(FuelType::generic) * fuelPowerForFuelType(ft);
+  const float heat = fuelHeatForFuelType(FuelType::generic) * fuelHeatForFuelType(ft);
+  const float cooler = maxSuggestedCoolerStrength();
+
+  if (volume <= 0 || cooler <= 0) {
+    return ret;
+  }
+
+  // faces of a cell that can see something other than casing
+  int faces = std::min<int>(2, x - 1) + std::min<int>(2, y - 1) + std::min<int>(2, z - 1);
+
+  for (int a = 0; a <= faces; a++) {
+    for (int m = 0; m <= faces; m++) {
+      // same formulas as Reactor::_cellContribution
+      float p = (1 + a) + (1 + a) * (m / 6.0);
+      float h = (a + 1) * (a + 2) / 2.0 + (1 + a) * (m / 3.0);
+
+      // volume taken up per cell: itself, its share of moderators, and the
+      // coolers needed to take its heat away
+      float cost = 1 + m / 6.0 + heat * h / cooler;
+
+      ret.effectivePower = std::max(ret.effectivePower, power * p * volume / cost);
+      if (cost <= volume) {
+        ret.efficiency = std::max(ret.efficiency, power * p);
+      }
+    }
+  }
+
+  // the cheapest cell to cool is an isolated one
+  ret.cells = volume / (1 + heat / cooler);
+
+  return ret;
+}
@@ -0,0 +1,37 @@
+#ifndef __BOUND_H__
+#define __BOUND_H__
+
+#include "Reactor.h"
+
+/** Optimistic ceilings on what any reactor of given dimensions can reach
+  * with a given fuel.
+  */
+struct ScoreBound {
+  // effectivePowerGenerated
+  float effectivePower;
+  // effectivePowerGenerated / totalCells
+  float efficiency;
+  // totalCells, heat adjusted (as objective_fn_cells)
+  float cells;
+};
+
+/** LP relaxation of the reactor layout.
+  *
+  * Every reactor cell is given a "configuration": a adjacent cells and m
+  * adjacent active moderators (each at most the number of faces that aren't
+  * casing). Adjacency consistency between cells is relaxed away; what stays
+  * is that every block needs its own place:
+  *
+  *   cells + moderators + coolers <= x * y * z
+  *   moderators >= sum(m * n_am) / 6    (a moderator touches <= 6 cells)
+  *   coolers * strongest cooler >= fuel heat of all cells
+  *
+  * (running hotter than the cooling only scales effective power down by
+  * cooling / heat, which the balanced solution with fewer cells matches).
+  * Substituting moderators and coolers leaves the volume as the only
+  * constraint, so the LP optimum puts every cell in the configuration with
+  * the best power per unit of volume it uses, and the bound is closed form.
+  */
+ScoreBound scoreBound(index_t x, index_t y, index_t z, FuelType ft);
+
+#endif
@@ -0,0 +1,198 @@
+#include "Checkpoint.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+// file layout: magic, raw size (uint64), FNV-1a of the raw bytes (uint64),
+// then the raw bytes PackBits-compressed
+static const char CHECKPOINT_MAGIC[8] = {'N', 'C', 'F', 'C', 'K', 'P', 'T', '1'};
+
+static uint64_t fnv1a(const std::vector<uint8_t> & data) {
+  uint64_t h = 14695981039346656037ULL;
+  for (uint8_t b : data) {
+    h ^= b;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/** PackBits: a header byte n < 128 is followed by n + 1 literal bytes,
+  * n > 128 by one byte repeated 257 - n times.
+  */
+static std::vector<uint8_t> packBits(const std::vector<uint8_t> & in) {
+  std::vector<uint8_t> out;
+  size_t i = 0;
+  while (i < in.size()) {
+    size_t run = 1;
+    while (i + run < in.size() && run < 128 && in[i + run] == in[i]) {
+      run++;
+    }
+
+    if (run >= 3) {
+      out.push_back(static_cast<uint8_t>(257 - run));
+      out.push_back(in[i]);
+      i += run;
+      continue;
+    }
+
+    // literals, up to the next run of 3
+    size_t start = i;
+    while (i < in.size() && i - start < 128) {
+      if (i + 2 < in.size() && in[i] == in[i + 1] && in[i] == in[i + 2]) {
+        break;
+      }
+      i++;
+    }
+    out.push_back(static_cast<uint8_t>(i - start - 1));
+    out.insert(out.end(), in.begin() + start, in.begin() + i);
+  }
+  return out;
+}
+
+static bool unpackBits(const std::vector<uint8_t> & in, size_t from, std::vector<uint8_t> & out, size_t size) {
+  out.clear();
+  // (no header byte expands to more than 128 bytes, so don't trust a size
+  // claiming more)
+  if (size / 128 > in.size() - from) {
+    return false;
+  }
+  out.reserve(size);
+  size_t i = from;
+  while (i < in.size() && out.size() < size) {
+    uint8_t n = in[i++];
+    if (n < 128) {
+      if (i + n + 1 > in.size()) {
+        return false;
+      }
+      out.insert(out.end(), in.begin() + i, in.begin() + i + n + 1);
+      i += n + 1;
+    }
+    else if (n > 128) {
+      if (i >= in.size()) {
+        return false;
+      }
+      out.insert(out.end(), 257 - n, in[i++]);
+    }
+  }
+  return out.size() == size;
+}
+
+void CheckpointWriter::putString(const std::string & s) {
+  put<uint64_t>(s.size());
+  _data.insert(_data.end(), s.begin(), s.end());
+}
+
+void CheckpointWriter::putReactor(Reactor & r) {
+  put<int32_t>(r.x());
+  put<int32_t>(r.y());
+  put<int32_t>(r.z());
+  for (index_t x = 0; x < r.x(); x++) {
+    for (index_t y = 0; y < r.y(); y++) {
+      for (index_t z = 0; z < r.z(); z++) {
+        put<uint8_t>(static_cast<uint8_t>(r.blockTypeAt(x, y, z)));
+      }
+    }
+  }
+  for (index_t x = 0; x < r.x(); x++) {
+    for (index_t y = 0; y < r.y(); y++) {
+      for (index_t z = 0; z < r.z(); z++) {
+        put<uint8_t>(static_cast<uint8_t>(r.coolerTypeAt(x, y, z)));
+      }
+    }
+  }
+}
+
+bool CheckpointWriter::writeFile(const std::string & path) const {
+  std::vector<uint8_t> packed = packBits(_data);
+  uint64_t size = _data.size();
+  uint64_t hash = fnv1a(_data);
+
+  std::string tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios_base::binary | std::ios_base::trunc);
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    out.write(reinterpret_cast<const char *>(&hash), sizeof(hash));
+    out.write(reinterpret_cast<const char *>(packed.data()), packed.size());
+    if (!out) {
+      fprintf(stderr, "couldn't write checkpoint %s\n", tmp.c_str());
+      return false;
+    }
+  }
+
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    fprintf(stderr, "couldn't replace %s\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+CheckpointReader::CheckpointReader(const std::string & path) : _pos(0), _ok(false) {
+  std::ifstream in(path, std::ios_base::binary);
+  if (!in) {
+    fprintf(stderr, "couldn't open checkpoint %s\n", path.c_str());
+    return;
+  }
+  std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  size_t header = sizeof(CHECKPOINT_MAGIC) + 2 * sizeof(uint64_t);
+  if (file.size() < header || memcmp(file.data(), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+    fprintf(stderr, "%s is not a checkpoint\n", path.c_str());
+    return;
+  }
+
+  uint64_t size, hash;
+  memcpy(&size, &file[sizeof(CHECKPOINT_MAGIC)], sizeof(size));
+  memcpy(&hash, &file[sizeof(CHECKPOINT_MAGIC) + sizeof(size)], sizeof(hash));
+
+  if (!unpackBits(file, header, _data, size) || fnv1a(_data) != hash) {
+    fprintf(stderr, "checkpoint %s is corrupt\n", path.c_str());
+    _data.clear();
+    return;
+  }
+  _ok = true;
+}
+
+bool CheckpointReader::getString(std::string & s) {
+  uint64_t size;
+  if (!get(size) || _pos + size > _data.size()) {
+    _ok = false;
+    return false;
+  }
+  s.assign(_data.begin() + _pos, _data.begin() + _pos + size);
+  _pos += size;
+  return true;
+}
+
+bool CheckpointReader::getReactor(Reactor & r) {
+  int32_t x, y, z;
+  if (!get(x) || !get(y) || !get(z) || !Reactor::validDimensions(x, y, z)) {
+    _ok = false;
+    return false;
+  }
+
+  size_t volume = (size_t)x * y * z;
+  if (_pos + 2 * volume > _data.size()) {
+    _ok = false;
+    return false;
+  }
+
+  r = Reactor(x, y, z);
+  const uint8_t * blocks = &_data[_pos];
+  const uint8_t * coolers = blocks + volume;
+  size_t n = 0;
+  for (index_t i = 0; i < x; i++) {
+    for (index_t j = 0; j < y; j++) {
+      for (index_t k = 0; k < z; k++, n++) {
+        if (blocks[n] >= static_cast<uint8_t>(BlockType::BLOCK_TYPE_MAX) || coolers[n] >= static_cast<uint8_t>(CoolerType::COOLER_TYPE_MAX)) {
+          _ok = false;
+          return false;
+        }
+        r.setCell(i, j, k, static_cast<BlockType>(blocks[n]), static_cast<CoolerType>(coolers[n]));
+      }
+    }
+  }
+  _pos += 2 * volume;
+  return true;
+}
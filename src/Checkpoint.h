@@ -0,0 +1,75 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+#include "Reactor.h"
+
+/** Flat binary image of search state, written with put* and read back in
+  * the same order with get*. Values are stored in native byte order, so
+  * checkpoints only move between machines of the same kind.
+  */
+class CheckpointWriter {
+public:
+  template <class T>
+  void put(const T & v) {
+    static_assert(std::is_trivially_copyable<T>::value, "put() copies bytes");
+    const uint8_t * p = reinterpret_cast<const uint8_t *>(&v);
+    _data.insert(_data.end(), p, p + sizeof(T));
+  }
+
+  void putString(const std::string & s);
+
+  /** Dimensions, then the block types and cooler types as two planes (long
+    * runs of air / the same block compress well).
+    */
+  void putReactor(Reactor & r);
+
+  /** Compress and write to `path` atomically (temporary file, then rename).
+    * @return false (with a message on stderr) if it couldn't be written
+    */
+  bool writeFile(const std::string & path) const;
+
+private:
+  std::vector<uint8_t> _data;
+};
+
+class CheckpointReader {
+public:
+  /** Read and decompress `path`; check ok() afterwards. */
+  CheckpointReader(const std::string & path);
+
+  /** False once the file couldn't be read or a get ran past the end. */
+  inline bool ok() const { return _ok; }
+
+  /** Bytes not read yet: check counts read from the file against it before
+    * allocating for them.
+    */
+  inline size_t remaining() const { return _data.size() - _pos; }
+
+  template <class T>
+  bool get(T & v) {
+    static_assert(std::is_trivially_copyable<T>::value, "get() copies bytes");
+    if (!_ok || _pos + sizeof(T) > _data.size()) {
+      _ok = false;
+      return false;
+    }
+    memcpy(&v, &_data[_pos], sizeof(T));
+    _pos += sizeof(T);
+    return true;
+  }
+
+  bool getString(std::string & s);
+  bool getReactor(Reactor & r);
+
+private:
+  std::vector<uint8_t> _data;
+  size_t _pos;
+  bool _ok;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "Convergence.h"
+
+#include <algorithm>
+#include <cmath>
+#include <climits>
+
+StopPolicy StopPolicy::forDimensions(index_t x, index_t y, index_t z) {
+  StopPolicy ret;
+  largecount_t volume = (largecount_t)x * y * z;
+  auto steps = [](largecount_t n) {
+    return (long)std::min<largecount_t>(n, LONG_MAX);
+  };
+  ret.maxSteps = steps(std::max<largecount_t>(20000, 160 * volume));
+  ret.stagnationWindow = steps(std::max<largecount_t>(500, 16 * volume));
+  ret.minSteps = steps(std::max<largecount_t>(500, 8 * volume));
+  return ret;
+}
+
+ConvergenceMonitor::ConvergenceMonitor(const StopPolicy & policy) {
+  _policy = policy;
+  _start = std::chrono::steady_clock::now();
+  _step = 0;
+  _lastImprovement = 0;
+  _bestObjective = -INFINITY;
+  _bestMetric = 0;
+  _diversity = -1;
+}
+
+void ConvergenceMonitor::observe(long step, float bestObjective, float bestMetric, float diversity) {
+  _step = step;
+  _bestMetric = bestMetric;
+
+  if (diversity >= 0) {
+    _diversity = diversity;
+  }
+
+  if (bestObjective > _bestObjective) {
+    _bestObjective = bestObjective;
+    _lastImprovement = step;
+    _improvements.push_back(std::make_pair(step, bestObjective));
+  }
+
+  // keep one record from before the window to compare against
+  while (_improvements.size() > 1 && _improvements[1].first <= step - _policy.stagnationWindow) {
+    _improvements.pop_front();
+  }
+}
+
+float ConvergenceMonitor::improvementRate() const {
+  if (_improvements.empty()) {
+    return 0;
+  }
+  // nothing to compare with before a whole window has passed
+  if (_improvements.front().first > _step - _policy.stagnationWindow) {
+    return INFINITY;
+  }
+  // (relative to the magnitude, so objectives that stay at or below zero
+  // can stagnate too)
+  float before = _improvements.front().second;
+  return (_bestObjective - before) / std::max(std::fabs(before), 1e-6f);
+}
+
+double ConvergenceMonitor::elapsedSeconds() const {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+}
+
+bool ConvergenceMonitor::shouldStop(std::string & why) const {
+  if (_policy.maxSteps && _step >= _policy.maxSteps) {
+    why = "step budget of " + std::to_string(_policy.maxSteps) + " used up";
+    return true;
+  }
+
+  if (_policy.maxSeconds > 0 && elapsedSeconds() >= _policy.maxSeconds) {
+    why = "time budget of " + std::to_string(_policy.maxSeconds) + "s used up";
+    return true;
+  }
+
+  if (_policy.target > 0 && _bestMetric >= _policy.target) {
+    why = "target of " + std::to_string(_policy.target) + " reached";
+    return true;
+  }
+
+  if (_policy.stagnationWindow && _step >= std::max(_policy.stagnationWindow, _policy.minSteps)
+      && improvementRate() < _policy.minImprovement) {
+    if (_diversity >= 0 && _diversity < _policy.minDiversity) {
+      why = "converged: no progress in " + std::to_string(_policy.stagnationWindow) + " steps and the population has collapsed";
+      return true;
+    }
+    if (stepsSinceBest() >= 2 * _policy.stagnationWindow) {
+      why = "stagnated: no new best in " + std::to_string(stepsSinceBest()) + " steps";
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ConvergenceMonitor::save(CheckpointWriter & out) const {
+  out.put(elapsedSeconds());
+  out.put(_step);
+  out.put(_lastImprovement);
+  out.put(_bestObjective);
+  out.put(_bestMetric);
+  out.put(_diversity);
+  out.put<uint64_t>(_improvements.size());
+  for (const auto & i : _improvements) {
+    out.put(i.first);
+    out.put(i.second);
+  }
+}
+
+bool ConvergenceMonitor::load(CheckpointReader & in) {
+  double elapsed;
+  uint64_t n;
+  if (!in.get(elapsed) || !in.get(_step) || !in.get(_lastImprovement) || !in.get(_bestObjective)
+      || !in.get(_bestMetric) || !in.get(_diversity) || !in.get(n)) {
+    return false;
+  }
+
+  _start = std::chrono::steady_clock::now() - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(elapsed));
+
+  _improvements.clear();
+  for (uint64_t i = 0; i < n; i++) {
+    std::pair<long, float> p;
+    if (!in.get(p.first) || !in.get(p.second)) {
+      return false;
+    }
+    _improvements.push_back(p);
+  }
+  return true;
+}
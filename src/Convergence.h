@@ -0,0 +1,90 @@
+#ifndef __CONVERGENCE_H__
+#define __CONVERGENCE_H__
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <utility>
+
+#include "Reactor.h"
+#include "Checkpoint.h"
+
+/** When a search should stop. Zero disables a criterion. */
+struct StopPolicy {
+  // hard step budget
+  long maxSteps = 20000;
+  // wall clock budget, seconds
+  double maxSeconds = 0;
+  // stop once the quantity the objective is after (see objectiveMetric)
+  // reaches this
+  float target = 0;
+  // never call a run converged / stagnated before this many steps
+  long minSteps = 0;
+  // window, in steps, over which progress is judged
+  long stagnationWindow = 0;
+  // relative improvement of the best objective over a window that still
+  // counts as progress
+  float minImprovement = 1e-3;
+  // mean fraction of cells differing between the parallel searches below
+  // which the population counts as collapsed
+  float minDiversity = 0.02;
+
+  /** Budgets that grow with the reactor: 160 steps per cell (at least
+    * 20k), a stagnation window of 16 steps per cell and at least 8 steps
+    * per cell before calling it (both at least 500).
+    */
+  static StopPolicy forDimensions(index_t x, index_t y, index_t z);
+};
+
+/** Tracks improvement rate, population diversity and time since the last
+  * best, and decides when further steps are unlikely to pay off:
+  *
+  * - the best objective improved by less than minImprovement over the last
+  *   stagnationWindow steps, and
+  * - either the parallel searches have collapsed onto (nearly) the same
+  *   design, or there hasn't been any new best for two windows.
+  */
+class ConvergenceMonitor {
+public:
+  ConvergenceMonitor(const StopPolicy & policy = StopPolicy());
+
+  /** Record the state after `step`. Pass diversity < 0 if it wasn't
+    * measured this step (it stays unknown if it never is, e.g. with a single
+    * search thread).
+    */
+  void observe(long step, float bestObjective, float bestMetric, float diversity);
+
+  /** @param why set to a human readable reason if stopping */
+  bool shouldStop(std::string & why) const;
+
+  /** Relative improvement of the best objective over the last window. */
+  float improvementRate() const;
+
+  inline long stepsSinceBest() const { return _step - _lastImprovement; }
+  inline float diversity() const { return _diversity; }
+  double elapsedSeconds() const;
+
+  inline const StopPolicy & policy() const { return _policy; }
+
+  /** Progress so far (not the policy); the clock carries on from the saved
+    * elapsed time.
+    */
+  void save(CheckpointWriter & out) const;
+  bool load(CheckpointReader & in);
+
+private:
+  StopPolicy _policy;
+  std::chrono::steady_clock::time_point _start;
+
+  long _step;
+  long _lastImprovement;
+  float _bestObjective;
+  float _bestMetric;
+  float _diversity;
+
+  // (step, best objective) at every improvement within the window, plus the
+  // last one before it
+  std::deque<std::pair<long, float> > _improvements;
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include "Diversity.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <mutex>
+
+Bitplanes::Bitplanes(Reactor & r, const SymmetryGroup::Element * symmetry) {
+  assign(r, symmetry);
+}
+
+void Bitplanes::assign(Reactor & r, const SymmetryGroup::Element * symmetry) {
+  size_t volume = r.volume();
+  _wordsPerPlane = (volume + 63) / 64;
+  _words.assign(PLANES * _wordsPerPlane, 0);
+
+  const SymmetryGroup::Element identity = {0, {(int64_t)r.y() * r.z(), r.z(), 1}, {r.x(), r.y(), r.z()}};
+  SymmetryGroup::Walk w(symmetry ? *symmetry : identity);
+  for (size_t n = 0; n < volume; n++, w.next()) {
+    uint64_t code = r.cellCode(*w);
+    for (int p = 0; p < PLANES; p++) {
+      _words[p * _wordsPerPlane + n / 64] |= ((code >> p) & 1) << (n % 64);
+    }
+  }
+}
+
+int Bitplanes::distance(const Bitplanes & a, const Bitplanes & b) {
+  const size_t w = a._wordsPerPlane;
+  const uint64_t * pa = a._words.data();
+  const uint64_t * pb = b._words.data();
+
+  int d = 0;
+  #pragma omp simd reduction(+:d)
+  for (size_t i = 0; i < w; i++) {
+    uint64_t diff = 0;
+    for (int p = 0; p < PLANES; p++) {
+      diff |= pa[p * w + i] ^ pb[p * w + i];
+    }
+    d += std::popcount(diff);
+  }
+  return d;
+}
+
+static_assert(Bitplanes::PLANES == Genome::BITS, "a genome holds the same planes");
+
+int Bitplanes::distance(const Bitplanes & a, const Genome & b) {
+  const size_t w = a._wordsPerPlane;
+  const uint64_t * pa = a._words.data();
+
+  int d = 0;
+  if (!b.chunked()) {
+    for (size_t i = 0; i < w; i++) {
+      uint64_t diff = 0;
+      for (int p = 0; p < PLANES; p++) {
+        diff |= pa[p * w + i] ^ b.planeWord(p, i);
+      }
+      d += std::popcount(diff);
+    }
+    return d;
+  }
+  for (size_t c = 0; c < b.chunks(); c++) {
+    const Genome::Chunk & chunk = b.chunk(c);
+    const size_t base = c * Genome::CHUNK_WORDS_PER_PLANE;
+    const size_t n = std::min<size_t>(Genome::CHUNK_WORDS_PER_PLANE, w - base);
+    for (size_t i = 0; i < n; i++) {
+      uint64_t diff = 0;
+      for (int p = 0; p < PLANES; p++) {
+        diff |= pa[p * w + base + i] ^ chunk.planes[p][i];
+      }
+      d += std::popcount(diff);
+    }
+  }
+  return d;
+}
+
+DiverseArchive::DiverseArchive(size_t k, int minDistance)
+  : _k(k), _minDistance(minDistance), _worst(-INFINITY)
+{
+}
+
+void DiverseArchive::_updateWorst() {
+  _worst = -INFINITY;
+  if (_entries.size() >= _k) {
+    _worst = INFINITY;
+    for (const Entry & e : _entries) {
+      _worst = std::min(_worst, e.score);
+    }
+  }
+}
+
+bool DiverseArchive::offer(Reactor & r, float score) {
+  if (!_k) {
+    return false;
+  }
+
+  {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    if (score <= _worst) {
+      return false;
+    }
+  }
+
+  // a member found again (itself or an image) is settled by its canonical
+  // hash, before encoding every image of it
+  const size_t canonical = canonicalHash(r);
+  {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    for (const Entry & e : _entries) {
+      if (e.canonical == canonical && e.score >= score) {
+        return false;
+      }
+    }
+  }
+
+  // every mirror image / rotation; element 0 (the identity) first. (thread
+  // local, so that offering doesn't allocate once warmed up)
+  const SymmetryGroup & group = SymmetryGroup::forDimensions(r.x(), r.y(), r.z());
+  static thread_local std::vector<Bitplanes> images;
+  images.resize(group.size());
+  for (size_t g = 0; g < group.size(); g++) {
+    images[g].assign(r, &group.element(g));
+  }
+
+  std::unique_lock<std::shared_mutex> lock(_mutex);
+  if (score <= _worst) {
+    return false;
+  }
+
+  // everything the candidate is too close to has to be worse
+  static thread_local std::vector<size_t> close;
+  close.clear();
+  for (size_t i = 0; i < _entries.size(); i++) {
+    int d = INT32_MAX;
+    for (const Bitplanes & image : images) {
+      d = std::min(d, Bitplanes::distance(image, _entries[i].genome));
+    }
+    if (d < _minDistance) {
+      if (_entries[i].score >= score) {
+        return false;
+      }
+      close.push_back(i);
+    }
+  }
+
+  for (auto i = close.rbegin(); i != close.rend(); i++) {
+    _entries.erase(_entries.begin() + *i);
+  }
+
+  _entries.push_back({score, Genome(r), canonical});
+
+  if (_entries.size() > _k) {
+    auto worst = std::min_element(_entries.begin(), _entries.end(), [](const Entry & a, const Entry & b) {
+      return a.score < b.score;
+    });
+    _entries.erase(worst);
+  }
+
+  _updateWorst();
+  return true;
+}
+
+size_t DiverseArchive::size() const {
+  std::shared_lock<std::shared_mutex> lock(_mutex);
+  return _entries.size();
+}
+
+std::vector<std::pair<float, Reactor> > DiverseArchive::members() const {
+  std::vector<std::pair<float, Reactor> > ret;
+  {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    for (const Entry & e : _entries) {
+      ret.emplace_back(e.score, e.genome.reactor());
+    }
+  }
+  std::stable_sort(ret.begin(), ret.end(), [](const std::pair<float, Reactor> & a, const std::pair<float, Reactor> & b) {
+    return a.first > b.first;
+  });
+  return ret;
+}
+
+void DiverseArchive::save(CheckpointWriter & out) const {
+  std::shared_lock<std::shared_mutex> lock(_mutex);
+  out.put<uint64_t>(_entries.size());
+  for (const Entry & e : _entries) {
+    Reactor r = e.genome.reactor();
+    out.put(e.score);
+    out.putReactor(r);
+  }
+}
+
+bool DiverseArchive::load(CheckpointReader & in) {
+  std::unique_lock<std::shared_mutex> lock(_mutex);
+  uint64_t n;
+  if (!in.get(n)) {
+    return false;
+  }
+  _entries.clear();
+  for (uint64_t i = 0; i < n; i++) {
+    Entry e;
+    Reactor r;
+    if (!in.get(e.score) || !in.getReactor(r)) {
+      return false;
+    }
+    e.genome = Genome(r);
+    e.canonical = canonicalHash(r);
+    _entries.push_back(std::move(e));
+  }
+  _updateWorst();
+  return true;
+}
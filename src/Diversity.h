@@ -0,0 +1,89 @@
+#ifndef __DIVERSITY_H__
+#define __DIVERSITY_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <shared_mutex>
+
+#include "Reactor.h"
+#include "Genome.h"
+#include "Symmetry.h"
+#include "Checkpoint.h"
+
+/** Compact encoding of a reactor for fast structural distances: every cell
+  * gets a 5 bit code (air, reactor cell, moderator, or which cooler), stored
+  * as 5 bitplanes of one bit per cell.
+  */
+class Bitplanes {
+public:
+  static const int PLANES = 5;
+
+  Bitplanes() {}
+
+  /** Encode `r`, or its image under a symmetry (a SymmetryGroup element). */
+  Bitplanes(Reactor & r, const SymmetryGroup::Element * symmetry = nullptr);
+
+  /** Same as constructing anew, but reusing the storage. */
+  void assign(Reactor & r, const SymmetryGroup::Element * symmetry = nullptr);
+
+  /** Number of cells whose contents differ; a and b must have the same
+    * dimensions. Popcount over the OR of the XORed planes, vectorised.
+    */
+  static int distance(const Bitplanes & a, const Bitplanes & b);
+  /** The same against a stored design (in the same cell order). */
+  static int distance(const Bitplanes & a, const Genome & b);
+
+private:
+  size_t _wordsPerPlane;
+  std::vector<uint64_t> _words;
+};
+
+/** The K best designs seen that are pairwise at least minDistance cells
+  * apart, none of them a mirror image or rotation of another (distances are
+  * taken to the nearest of a candidate's images under its SymmetryGroup).
+  *
+  * A candidate closer than minDistance to members only gets in if it beats
+  * all of them, and then replaces them. Safe to offer to from several
+  * threads at once.
+  */
+class DiverseArchive {
+public:
+  DiverseArchive(size_t k = 0, int minDistance = 1);
+
+  /** @return whether `r` was added */
+  bool offer(Reactor & r, float score);
+
+  size_t size() const;
+  inline size_t capacity() const { return _k; }
+  inline int minDistance() const { return _minDistance; }
+
+  /** Copy of the members, best first. */
+  std::vector<std::pair<float, Reactor> > members() const;
+
+  void save(CheckpointWriter & out) const;
+  bool load(CheckpointReader & in);
+
+private:
+  struct Entry {
+    float score;
+    // (distances are taken to it directly: it is laid out like Bitplanes,
+    // and shares chunks with the other members)
+    Genome genome;
+    // canonicalHash, the same for all its mirror images / rotations
+    size_t canonical;
+  };
+
+  size_t _k;
+  int _minDistance;
+
+  mutable std::shared_mutex _mutex;
+  std::vector<Entry> _entries;
+  // lowest score in a full archive, so most candidates are turned away
+  // without encoding them
+  float _worst;
+
+  void _updateWorst();
+};
+
+#endif
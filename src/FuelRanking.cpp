@@ -0,0 +1,147 @@
+#include "FuelRanking.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+#include <omp.h>
+
+#include "Reactor.h"
+
+std::vector<std::string> collectDesigns(const std::vector<std::string> & paths) {
+  std::vector<std::string> ret;
+  for (const std::string & p : paths) {
+    std::error_code ec;
+    if (!std::filesystem::is_directory(p, ec)) {
+      ret.push_back(p);
+      continue;
+    }
+
+    std::vector<std::string> found;
+    for (auto it = std::filesystem::recursive_directory_iterator(p, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+      if (it->is_regular_file(ec) && it->path().extension() == ".json") {
+        found.push_back(it->path().string());
+      }
+    }
+    std::sort(found.begin(), found.end());
+    ret.insert(ret.end(), found.begin(), found.end());
+  }
+  return ret;
+}
+
+struct FuelRank {
+  bool loaded = false;
+  int x = 0, y = 0, z = 0;
+  int cells = 0;
+  int inactive = 0;
+  // best and runner-up, by effective output
+  FuelType fuel = FuelType::air;
+  float effective = 0;
+  float heat = 0;
+  FuelType secondFuel = FuelType::air;
+  float secondEffective = 0;
+};
+
+int rankFuels(const std::vector<std::string> & files, const std::string & csvPath) {
+  std::vector<FuelType> fuels;
+  for (int f = 2; f < static_cast<int>(FuelType::FUEL_TYPE_MAX); f++) {
+    fuels.push_back(static_cast<FuelType>(f));
+  }
+
+  std::vector<FuelRank> ranks(files.size());
+  double t0 = omp_get_wtime();
+
+  #pragma omp parallel
+  {
+    std::vector<float> power(fuels.size()), heat(fuels.size()), effective(fuels.size());
+
+    #pragma omp for schedule(dynamic, 16)
+    for (size_t i = 0; i < files.size(); i++) {
+      Reactor * r = Reactor::fromJsonFile(files[i]);
+      if (!r) {
+        continue;
+      }
+
+      r->fuelTotals(fuels.data(), fuels.size(), power.data(), heat.data(), effective.data());
+
+      FuelRank & rank = ranks[i];
+      rank.loaded = true;
+      rank.x = r->x();
+      rank.y = r->y();
+      rank.z = r->z();
+      rank.cells = r->totalCells();
+      rank.inactive = r->inactiveBlocks();
+
+      size_t best = 0, second = fuels.size() > 1 ? 1 : 0;
+      if (effective[second] > effective[best]) {
+        std::swap(best, second);
+      }
+      for (size_t k = 2; k < fuels.size(); k++) {
+        if (effective[k] > effective[best]) {
+          second = best;
+          best = k;
+        }
+        else if (effective[k] > effective[second]) {
+          second = k;
+        }
+      }
+
+      rank.fuel = fuels[best];
+      rank.effective = effective[best];
+      rank.heat = heat[best];
+      rank.secondFuel = fuels[second];
+      rank.secondEffective = effective[second];
+
+      delete r;
+    }
+  }
+
+  std::vector<size_t> order;
+  int failed = 0;
+  for (size_t i = 0; i < files.size(); i++) {
+    if (ranks[i].loaded) {
+      order.push_back(i);
+    }
+    else {
+      failed++;
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return ranks[a].effective > ranks[b].effective;
+  });
+
+  fprintf(stderr, "ranked %zu designs in %.2fs (%d couldn't be loaded)\n", order.size(), omp_get_wtime() - t0, failed);
+
+  FILE * out = csvPath == "-" ? stdout : fopen(csvPath.c_str(), "w");
+  if (!out) {
+    fprintf(stderr, "couldn't write %s\n", csvPath.c_str());
+    return -1;
+  }
+
+  fprintf(out, "rank,file,x,y,z,cells,inactive,fuel,effectiveOutput,perCell,heat,runnerUp,runnerUpOutput\n");
+  int n = 1;
+  for (size_t i : order) {
+    const FuelRank & r = ranks[i];
+    // quote the path; CSV escapes quotes by doubling them
+    std::string file = files[i];
+    for (size_t q = file.find('"'); q != std::string::npos; q = file.find('"', q + 2)) {
+      file.insert(q, 1, '"');
+    }
+    fprintf(out, "%d,\"%s\",%d,%d,%d,%d,%d,%s,%f,%f,%f,%s,%f\n", n++, file.c_str(), r.x, r.y, r.z, r.cells, r.inactive,
+      fuelNameForFuelType(r.fuel).c_str(), r.effective, r.effective / std::max(r.cells, 1), r.heat,
+      fuelNameForFuelType(r.secondFuel).c_str(), r.secondEffective);
+  }
+
+  bool written = !ferror(out);
+  if (out != stdout) {
+    written = fclose(out) == 0 && written;
+  }
+  else {
+    written = fflush(out) == 0 && written;
+  }
+  if (!written) {
+    fprintf(stderr, "couldn't write %s\n", csvPath.c_str());
+    return -1;
+  }
+  return failed;
+}
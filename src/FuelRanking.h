@@ -0,0 +1,22 @@
+#ifndef __FUEL_RANKING_H__
+#define __FUEL_RANKING_H__
+
+#include <string>
+#include <vector>
+
+/** Hellrage JSON files among `paths`: files as given, directories searched
+  * recursively for *.json.
+  */
+std::vector<std::string> collectDesigns(const std::vector<std::string> & paths);
+
+/** Load every design (in parallel), evaluate it once, and score it against
+  * every fuel at once (Reactor::fuelTotals). Writes a CSV to `csvPath`
+  * ("-": stdout), one row per design, best effective output first, with
+  * the fuel it runs best on and the runner up.
+  *
+  * @return number of designs that couldn't be loaded, or -1 if the CSV
+  *         couldn't be written
+  */
+int rankFuels(const std::vector<std::string> & files, const std::string & csvPath);
+
+#endif
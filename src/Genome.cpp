@@ -0,0 +1,126 @@
+#include "Genome.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+/** Every chunk some genome holds, by content hash, so that a new chunk
+  * equal to one of them is shared rather than stored again. Chunks take
+  * themselves out when the last genome lets go of them.
+  */
+struct ChunkPool {
+  struct Slot {
+    const Genome::Chunk * chunk;
+    std::weak_ptr<const Genome::Chunk> ref;
+  };
+
+  std::mutex mutex;
+  std::unordered_multimap<uint64_t, Slot> slots;
+
+  std::shared_ptr<const Genome::Chunk> intern(const Genome::Chunk & c) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = slots.equal_range(c.hash);
+    for (auto i = range.first; i != range.second; i++) {
+      // (a chunk on its way out is still there to compare, but can't be
+      // had any more)
+      if (i->second.chunk->planes == c.planes) {
+        if (std::shared_ptr<const Genome::Chunk> ret = i->second.ref.lock()) {
+          return ret;
+        }
+      }
+    }
+
+    std::shared_ptr<const Genome::Chunk> ret(new Genome::Chunk(c), [this](const Genome::Chunk * dead) {
+      release(dead);
+    });
+    slots.emplace(c.hash, Slot { ret.get(), ret });
+    return ret;
+  }
+
+  void release(const Genome::Chunk * dead) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto range = slots.equal_range(dead->hash);
+      for (auto i = range.first; i != range.second; i++) {
+        if (i->second.chunk == dead) {
+          slots.erase(i);
+          break;
+        }
+      }
+    }
+    delete dead;
+  }
+};
+
+// never destroyed, as genomes in static storage may outlive it
+ChunkPool & pool() {
+  static ChunkPool * ret = new ChunkPool;
+  return *ret;
+}
+
+uint64_t chunkHash(const Genome::Chunk & c) {
+  uint64_t h = 0;
+  for (const auto & plane : c.planes) {
+    for (uint64_t w : plane) {
+      // splitmix64 finaliser
+      h = (h ^ w) + 0x9e3779b97f4a7c15ULL;
+      h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+      h ^= h >> 31;
+    }
+  }
+  return h;
+}
+
+}
+
+Genome::Genome(const Reactor & r) : _x(r.x()), _y(r.y()), _z(r.z()), _hash(r.contentHash()) {
+  largecount_t volume = r.volume();
+  if (!chunked()) {
+    _words.assign((BITS * volume + 63) / 64, 0);
+    for (vector_offset_t n = 0; n < volume; n++) {
+      uint64_t code = r.cellCode(n);
+      for (int p = 0; p < BITS; p++) {
+        vector_offset_t bit = p * volume + n;
+        _words[bit / 64] |= (code >> p & 1) << (bit % 64);
+      }
+    }
+    return;
+  }
+
+  _chunks.reserve((volume + CHUNK_CELLS - 1) / CHUNK_CELLS);
+  for (vector_offset_t base = 0; base < volume; base += CHUNK_CELLS) {
+    Chunk c = {};
+    int cells = (int)std::min<largecount_t>(CHUNK_CELLS, volume - base);
+    for (int i = 0; i < cells; i++) {
+      uint64_t code = r.cellCode(base + i);
+      for (int p = 0; p < BITS; p++) {
+        c.planes[p][i / 64] |= (code >> p & 1) << (i % 64);
+      }
+    }
+    c.hash = chunkHash(c);
+    _chunks.push_back(pool().intern(c));
+  }
+}
+
+Reactor Genome::reactor() const {
+  Reactor ret(_x, _y, _z);
+  largecount_t volume = ret.volume();
+  for (vector_offset_t n = 0; n < volume; n++) {
+    ret.setCellCode(n, codeAt(n));
+  }
+  return ret;
+}
+
+void Genome::chunkStats(size_t & distinct, size_t & references) {
+  ChunkPool & p = pool();
+  std::lock_guard<std::mutex> lock(p.mutex);
+  distinct = 0;
+  references = 0;
+  for (const auto & slot : p.slots) {
+    long uses = slot.second.ref.use_count();
+    distinct += uses > 0;
+    references += uses;
+  }
+}
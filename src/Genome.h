@@ -0,0 +1,127 @@
+#ifndef __GENOME_H__
+#define __GENOME_H__
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Reactor.h"
+
+/** Just the design of a reactor, for storing many of them: dimensions and
+  * each cell's 5 bit Reactor::cellCode, as 5 bitplanes (the layout of
+  * Bitplanes).
+  *
+  * Designs of up to INLINE_CELLS cells keep their planes to themselves,
+  * back to back with no padding (a 9x9x9 takes 456 bytes). Larger ones are
+  * cut into chunks of CHUNK_CELLS cells that never change once made, and
+  * every Genome with the same contents in a chunk shares one copy of it:
+  * archive members a few edits apart, and the empty stretches of sparse
+  * designs, cost one chunk pointer each. So stored designs take memory in
+  * proportion to how they differ, not to their volume. None of a Reactor's
+  * evaluation state is kept; reactor() turns it back into something that
+  * can be scored.
+  */
+class Genome {
+public:
+  static const int BITS = 5;
+  static const int CHUNK_CELLS = 512;
+  static const int CHUNK_WORDS_PER_PLANE = CHUNK_CELLS / 64;
+  // below this, a chunk's pointer, count and hash would cost more than
+  // sharing it saves
+  static const int INLINE_CELLS = 4 * CHUNK_CELLS;
+
+  struct Chunk {
+    // plane p, cell n of the chunk: bit n % 64 of planes[p][n / 64]
+    std::array<std::array<uint64_t, CHUNK_WORDS_PER_PLANE>, BITS> planes;
+    uint64_t hash;
+  };
+
+  Genome() : _x(0), _y(0), _z(0), _hash(0) {}
+  explicit Genome(const Reactor & r);
+
+  /** A fresh (unevaluated) reactor with this design. */
+  Reactor reactor() const;
+
+  inline uint8_t codeAt(vector_offset_t n) const {
+    if (!chunked()) {
+      uint8_t ret = 0;
+      for (int p = 0; p < BITS; p++) {
+        vector_offset_t bit = p * volume() + n;
+        ret |= (_words[bit / 64] >> (bit % 64) & 1) << p;
+      }
+      return ret;
+    }
+    const Chunk & c = *_chunks[n / CHUNK_CELLS];
+    int i = n % CHUNK_CELLS;
+    uint8_t ret = 0;
+    for (int p = 0; p < BITS; p++) {
+      ret |= (c.planes[p][i / 64] >> (i % 64) & 1) << p;
+    }
+    return ret;
+  }
+
+  inline largecount_t volume() const { return (largecount_t)_x * _y * _z; }
+  inline index_t x() const { return _x; }
+  inline index_t y() const { return _y; }
+  inline index_t z() const { return _z; }
+
+  /** Reactor::contentHash of the design. */
+  inline uint64_t contentHash() const { return _hash; }
+
+  /** Whether the design is held in shared chunks, or inline. */
+  inline bool chunked() const { return volume() > INLINE_CELLS; }
+
+  /** Word i of plane p (cells 64 * i on, zeros past the end) of an inline
+    * design.
+    */
+  inline uint64_t planeWord(int p, size_t i) const {
+    const size_t bit = (size_t)(p * volume()) + 64 * i;
+    const size_t w = bit / 64, s = bit % 64;
+    uint64_t ret = _words[w] >> s;
+    if (s && w + 1 < _words.size()) {
+      ret |= _words[w + 1] << (64 - s);
+    }
+    // (the rest is the next plane)
+    const size_t left = (size_t)volume() - 64 * i;
+    return left < 64 ? ret & ((1ULL << left) - 1) : ret;
+  }
+
+  /** Chunk i of a chunked design, cells i * CHUNK_CELLS on (zeros past the end). */
+  inline const Chunk & chunk(size_t i) const { return *_chunks[i]; }
+  inline size_t chunks() const { return _chunks.size(); }
+
+  /** Heap bytes of this genome as if it shared nothing. */
+  inline size_t bytes() const {
+    return _words.size() * sizeof(uint64_t) + _chunks.size() * (sizeof(std::shared_ptr<const Chunk>) + sizeof(Chunk));
+  }
+
+  /** Chunks held by all genomes together: `distinct` ones, `references`
+    * to them.
+    */
+  static void chunkStats(size_t & distinct, size_t & references);
+
+  inline bool operator==(const Genome & b) const {
+    if (_hash != b._hash || _x != b._x || _y != b._y || _z != b._z) {
+      return false;
+    }
+    if (_words != b._words) {
+      return false;
+    }
+    for (size_t i = 0; i < _chunks.size(); i++) {
+      if (_chunks[i] != b._chunks[i] && _chunks[i]->planes != b._chunks[i]->planes) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  index_t _x, _y, _z;
+  uint64_t _hash;
+  // inline: plane p is bits p * volume() on
+  std::vector<uint64_t> _words;
+  std::vector<std::shared_ptr<const Chunk> > _chunks;
+};
+
+#endif
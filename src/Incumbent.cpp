@@ -0,0 +1,171 @@
+#include "Incumbent.h"
+
+#include <cstdio>
+#include <iostream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// longest the writer waits for a slow reader to take the rest of a line it
+// has started writing, before giving up on that reader
+#define STREAM_STALL_MS 1000
+
+IncumbentWriter::IncumbentWriter(const std::string & jsonPath, const std::string & streamPath)
+  : _jsonPath(jsonPath), _streamPath(streamPath),
+#ifndef _WIN32
+    _fd(-1),
+#endif
+    _closing(false)
+{
+  _thread = std::thread(&IncumbentWriter::_run, this);
+}
+
+IncumbentWriter::~IncumbentWriter() {
+  close();
+}
+
+void IncumbentWriter::publish(const Reactor & r, const Json::Value & info) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _queue.emplace_back(r, info);
+  }
+  _wake.notify_one();
+}
+
+void IncumbentWriter::close() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closing = true;
+  }
+  _wake.notify_one();
+
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+
+#ifndef _WIN32
+  if (_fd >= 0 && _fd != STDOUT_FILENO) {
+    ::close(_fd);
+  }
+  _fd = -1;
+#endif
+}
+
+void IncumbentWriter::_writeJsonFile(Reactor & r) {
+  if (_jsonPath.empty()) {
+    return;
+  }
+
+  std::string tmp = _jsonPath + ".tmp";
+  r.toJsonFile(tmp);
+  if (std::rename(tmp.c_str(), _jsonPath.c_str()) != 0) {
+    fprintf(stderr, "couldn't replace %s\n", _jsonPath.c_str());
+  }
+}
+
+bool IncumbentWriter::_openStream() {
+  if (_streamPath.empty()) {
+    return false;
+  }
+#ifdef _WIN32
+  if (_streamPath != "-" && !_stream.is_open()) {
+    _stream.open(_streamPath, std::ios_base::out | std::ios_base::app);
+  }
+  return _streamPath == "-" || _stream.is_open();
+#else
+  if (_fd < 0) {
+    // a FIFO without a reader fails to open (ENXIO) rather than blocking
+    _fd = _streamPath == "-" ? STDOUT_FILENO
+      : open(_streamPath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_NONBLOCK, 0666);
+  }
+  return _fd >= 0;
+#endif
+}
+
+void IncumbentWriter::_writeLine(const std::string & line) {
+#ifdef _WIN32
+  std::ostream & out = _streamPath == "-" ? std::cout : _stream;
+  out << line << std::flush;
+#else
+  size_t done = 0;
+  int stalled = 0;
+  while (done < line.size()) {
+    ssize_t n = write(_fd, line.data() + done, line.size() - done);
+    if (n > 0) {
+      done += n;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      if (!done) {
+        // the reader is behind: this line is dropped
+        return;
+      }
+      if (stalled < STREAM_STALL_MS) {
+        pollfd p = { _fd, POLLOUT, 0 };
+        poll(&p, 1, 10);
+        stalled += 10;
+        continue;
+      }
+    }
+
+    // the reader went away (EPIPE) or stopped halfway through a line; the
+    // next batch tries for a new one
+    if (_fd != STDOUT_FILENO) {
+      ::close(_fd);
+    }
+    _fd = -1;
+    return;
+  }
+#endif
+}
+
+void IncumbentWriter::_run() {
+#ifndef _WIN32
+  // a reader going away should be an EPIPE from write, not the end of the
+  // process
+  sigset_t pipe;
+  sigemptyset(&pipe);
+  sigaddset(&pipe, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe, nullptr);
+#endif
+
+  Json::StreamWriterBuilder lineWriter;
+  lineWriter["indentation"] = "";
+
+  while (true) {
+    std::deque<std::pair<Reactor, Json::Value> > batch;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this] { return _closing || !_queue.empty(); });
+      if (_queue.empty() && _closing) {
+        break;
+      }
+      batch.swap(_queue);
+    }
+
+    // only the newest one matters on disk; written first, so that the file
+    // is current whatever happens to the stream
+    _writeJsonFile(batch.back().first);
+
+    if (_openStream()) {
+      for (auto & item : batch) {
+        Json::Value line = item.second;
+        line["Reactor"] = item.first.toJson();
+        _writeLine(Json::writeString(lineWriter, line) + '\n');
+#ifndef _WIN32
+        if (_fd < 0) {
+          break;
+        }
+#endif
+      }
+    }
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef __INCUMBENT_H__
+#define __INCUMBENT_H__
+
+#include <string>
+#include <deque>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+
+#include <json/json.h>
+
+#include "Reactor.h"
+
+/** Writes incumbents from a background thread, so that I/O never holds up
+  * the search.
+  *
+  * The Hellrage JSON file is replaced atomically (write to a temporary,
+  * then rename) with the latest published incumbent, and every one is
+  * streamed as one JSON line (its info plus the Hellrage JSON under
+  * "Reactor").
+  *
+  * The stream never blocks the writer: a FIFO nobody has open for reading
+  * yet, or whose reader falls behind, just misses lines (opening it is
+  * retried with every batch), so close() always returns promptly.
+  */
+class IncumbentWriter {
+public:
+  /** @param jsonPath Hellrage JSON file kept up to date with the incumbent
+    * @param streamPath where to stream JSON lines: "-" for stdout, "" for
+    *        nowhere, anything else is opened for appending (e.g. a FIFO)
+    */
+  IncumbentWriter(const std::string & jsonPath, const std::string & streamPath = "");
+  ~IncumbentWriter();
+
+  IncumbentWriter(const IncumbentWriter &) = delete;
+  IncumbentWriter & operator=(const IncumbentWriter &) = delete;
+
+  /** Queue an incumbent for writing; returns right away. */
+  void publish(const Reactor & r, const Json::Value & info);
+
+  /** Write everything queued, then stop the writer thread. */
+  void close();
+
+private:
+  void _run();
+  void _writeJsonFile(Reactor & r);
+  /** Open the stream if it isn't yet; false if it can't be right now. */
+  bool _openStream();
+  /** Write one whole line, or (if the reader isn't keeping up) close the
+    * stream rather than wait.
+    */
+  void _writeLine(const std::string & line);
+
+  std::string _jsonPath;
+  std::string _streamPath;
+#ifdef _WIN32
+  std::ofstream _stream;
+#else
+  int _fd;
+#endif
+
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::deque<std::pair<Reactor, Json::Value> > _queue;
+  bool _closing;
+
+  std::thread _thread;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "Pareto.h"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+
+ParetoArchive::Point ParetoArchive::pointOf(Reactor & r, FuelType f) {
+  float effective = r.effectivePowerGenerated(f);
+  float cells = r.totalCells();
+  return {effective, effective / std::max(cells, 1.f), cells, (float)r.totalCoolers()};
+}
+
+bool ParetoArchive::dominates(const Point & a, const Point & b) {
+  bool noWorse = a.effectivePower >= b.effectivePower && a.efficiency >= b.efficiency
+    && a.cells >= b.cells && a.coolers <= b.coolers;
+  bool better = a.effectivePower > b.effectivePower || a.efficiency > b.efficiency
+    || a.cells > b.cells || a.coolers < b.coolers;
+  return noWorse && better;
+}
+
+bool ParetoArchive::_covered(const Point & p, uint64_t hash) const {
+  for (size_t i = 0; i < _points.size(); i++) {
+    const Point & q = _points[i];
+    if (dominates(q, p) || (_equal(q, p) && _genomes[i].contentHash() <= hash)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ParetoArchive::_equal(const Point & a, const Point & b) {
+  return a.effectivePower == b.effectivePower && a.efficiency == b.efficiency
+    && a.cells == b.cells && a.coolers == b.coolers;
+}
+
+bool ParetoArchive::offer(Reactor & r, FuelType f) {
+  if (r.inactiveBlocks() != 0 || r.totalCells() == 0) {
+    return false;
+  }
+
+  Point p = pointOf(r, f);
+  if (p.effectivePower <= 0) {
+    return false;
+  }
+  uint64_t hash = r.contentHash();
+
+  {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    if (_covered(p, hash)) {
+      return false;
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(_mutex);
+  // someone else may have got in in the meantime
+  if (_covered(p, hash)) {
+    return false;
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < _points.size(); i++) {
+    if (!dominates(p, _points[i]) && !_equal(p, _points[i])) {
+      if (n != i) {
+        _points[n] = _points[i];
+        _genomes[n] = std::move(_genomes[i]);
+      }
+      n++;
+    }
+  }
+  _points.resize(n);
+  _genomes.resize(n);
+
+  // members are kept in order of (point, content hash), so that which
+  // member is where doesn't depend on the order threads offered them in
+  auto before = [&](size_t i) {
+    const Point & q = _points[i];
+    if (q.effectivePower != p.effectivePower) return q.effectivePower > p.effectivePower;
+    if (q.efficiency != p.efficiency) return q.efficiency > p.efficiency;
+    if (q.cells != p.cells) return q.cells > p.cells;
+    if (q.coolers != p.coolers) return q.coolers < p.coolers;
+    return _genomes[i].contentHash() < hash;
+  };
+  size_t at = 0;
+  while (at < n && before(at)) {
+    at++;
+  }
+  _points.insert(_points.begin() + at, p);
+  _genomes.emplace(_genomes.begin() + at, r);
+  return true;
+}
+
+size_t ParetoArchive::size() const {
+  std::shared_lock<std::shared_mutex> lock(_mutex);
+  return _points.size();
+}
+
+Reactor ParetoArchive::member(size_t i) const {
+  std::shared_lock<std::shared_mutex> lock(_mutex);
+  return _genomes[i].reactor();
+}
+
+std::vector<std::pair<ParetoArchive::Point, Reactor> > ParetoArchive::front() const {
+  std::vector<std::pair<Point, Reactor> > ret;
+  {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    for (size_t i = 0; i < _points.size(); i++) {
+      ret.emplace_back(_points[i], _genomes[i].reactor());
+    }
+  }
+  std::stable_sort(ret.begin(), ret.end(), [](const std::pair<Point, Reactor> & a, const std::pair<Point, Reactor> & b) {
+    return a.first.effectivePower > b.first.effectivePower;
+  });
+  return ret;
+}
+
+void ParetoArchive::toJsonFile(const std::string & fn) const {
+  Json::Value out(Json::arrayValue);
+  for (auto & member : front()) {
+    Json::Value entry;
+    entry["EffectiveOutput"] = member.first.effectivePower;
+    entry["OutputPerCell"] = member.first.efficiency;
+    entry["Cells"] = (int)member.first.cells;
+    entry["Coolers"] = (int)member.first.coolers;
+    entry["Reactor"] = member.second.toJson();
+    out.append(entry);
+  }
+
+  std::ofstream outfile(fn, std::ios_base::binary);
+  outfile << out;
+}
+
+void ParetoArchive::save(CheckpointWriter & out) const {
+  std::shared_lock<std::shared_mutex> lock(_mutex);
+  out.put<uint64_t>(_points.size());
+  for (size_t i = 0; i < _points.size(); i++) {
+    Reactor r = _genomes[i].reactor();
+    out.put(_points[i]);
+    out.putReactor(r);
+  }
+}
+
+bool ParetoArchive::load(CheckpointReader & in) {
+  std::unique_lock<std::shared_mutex> lock(_mutex);
+  uint64_t n;
+  // every member takes at least a point and reactor dimensions
+  if (!in.get(n) || n > in.remaining() / (sizeof(Point) + 3 * sizeof(int32_t))) {
+    return false;
+  }
+  _points.resize(n);
+  _genomes.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    Reactor r;
+    if (!in.get(_points[i]) || !in.getReactor(r)) {
+      return false;
+    }
+    _genomes[i] = Genome(r);
+  }
+  return true;
+}
@@ -0,0 +1,72 @@
+#ifndef __PARETO_H__
+#define __PARETO_H__
+
+#include <string>
+#include <vector>
+#include <shared_mutex>
+
+#include "Reactor.h"
+#include "Genome.h"
+#include "Checkpoint.h"
+
+/** Designs that aren't dominated on (effective output, output per cell,
+  * cell count, cooler count): more is better for the first three, fewer
+  * coolers is better. Only designs without inactive blocks qualify.
+  *
+  * Safe to offer to from several threads at once. Most candidates are
+  * dominated and only need a shared lock to be turned away; insertion
+  * (which drops whatever the newcomer dominates) takes the exclusive lock.
+  */
+class ParetoArchive {
+public:
+  struct Point {
+    float effectivePower;
+    float efficiency;
+    float cells;
+    float coolers;
+  };
+
+  static Point pointOf(Reactor & r, FuelType f);
+
+  /** @return whether `a` is at least as good as `b` everywhere and better
+    *         somewhere
+    */
+  static bool dominates(const Point & a, const Point & b);
+
+  /** Add `r` if nothing in the archive dominates it or equals it with a
+    * lower Reactor::contentHash (so that, whatever order candidates come in,
+    * the archive ends up the same).
+    * @return whether it was added
+    */
+  bool offer(Reactor & r, FuelType f);
+
+  size_t size() const;
+
+  /** Copy of the archive, by effective output, highest first. */
+  std::vector<std::pair<Point, Reactor> > front() const;
+
+  /** Copy of one member; `i` < size(). Members are in a fixed order (by
+    * effective output, highest first), whichever order they came in.
+    */
+  Reactor member(size_t i) const;
+
+  /** The front as a JSON array of {EffectiveOutput, OutputPerCell, Cells,
+    * Coolers, Reactor (Hellrage JSON)}.
+    */
+  void toJsonFile(const std::string & fn) const;
+
+  void save(CheckpointWriter & out) const;
+  bool load(CheckpointReader & in);
+
+private:
+  // true if something in the archive dominates p, or equals it with a
+  // content hash no higher than `hash`
+  bool _covered(const Point & p, uint64_t hash) const;
+  static bool _equal(const Point & a, const Point & b);
+
+  mutable std::shared_mutex _mutex;
+  std::vector<Point> _points;
+  std::vector<Genome> _genomes;
+};
+
+#endif
@@ -12,11 +12,21 @@
 #include <algorithm>
 #include <set>
 #include <array>
+#include <bit>
+#include <cstring>
 
 #include <json/json.h>
 
 #define RULESET_VANILLA
 
+// evaluate mirror symmetric reactors on one octant (see Reactor::_evaluate);
+// build with -DVERIFY_SYMMETRIC_EVALUATION to check every such evaluation
+// against a full one
+#define SYMMETRIC_EVALUATION
+
+// build with -DVERIFY_SPARSE_EVALUATION to check every evaluation of a
+// mostly empty reactor (see SPARSE_EVALUATION_OCCUPANCY) against a full one
+
 static std::map<CoolerType, float> coolerStrengths_E2E = {
   {CoolerType::air, 0},
   {CoolerType::water, 20},
@@ -283,6 +293,11 @@ static float fuel_heat_vanilla[] = {
   900.0
 };
 
+// mutation proposal weights, see Reactor::mutationWeights
+#define MUTATION_WEIGHT_BASE 1.0f
+#define MUTATION_WEIGHT_WASTED 8.0f
+#define MUTATION_WEIGHT_WEAK 3.0f
+
 #ifdef RULESET_E2E
 static std::map<CoolerType, float> coolerStrengths = coolerStrengths_E2E;
 static float * fuel_power = fuel_power_E2E;
@@ -357,6 +372,15 @@ static std::string fuel_names[] = {
     "FUEL_TYPE_MAX"
 };
 
+// coolers the search is allowed to suggest / repair with
+static const std::set<CoolerType> suggestedCoolerWhitelist = {
+  CoolerType::redstone, CoolerType::gold, CoolerType::diamond,
+  CoolerType::iron, CoolerType::lapis, CoolerType::tin,
+  CoolerType::glowstone, CoolerType::quartz, CoolerType::copper, CoolerType::magnesium, 
+  CoolerType::cryotheum, CoolerType::enderium, CoolerType::liquidHelium,
+  // CoolerType::activeCryotheum,
+};
+
 std::map<std::string, std::tuple<BlockType, CoolerType> > stringToBlockType = {
   {"FuelCell", std::make_tuple(BlockType::reactorCell, CoolerType::air)},
   {"Graphite", std::make_tuple(BlockType::moderator, CoolerType::air)},
@@ -390,20 +414,42 @@ Reactor * Reactor::fromJsonFile(std::string fn)
     return nullptr;
   }
 
-  fs >> root;
+  // (may be called from several threads at once: nothing shared is
+  // modified here)
+  Reactor * out = nullptr;
+  try {
+    fs >> root;
+
+    int x = root["InteriorDimensions"]["X"].asInt();
+    int y = root["InteriorDimensions"]["Y"].asInt();
+    int z = root["InteriorDimensions"]["Z"].asInt();
+    if (!validDimensions(x, y, z)) {
+      fprintf(stderr, "%s: bad dimensions\n", fn.c_str());
+      return nullptr;
+    }
 
-  Reactor * out = new Reactor(root["InteriorDimensions"]["X"].asInt(), root["InteriorDimensions"]["Y"].asInt(), root["InteriorDimensions"]["Z"].asInt());
+    out = new Reactor(x, y, z);
 
-  for (std::string & k : root["CompressedReactor"].getMemberNames()) {
-    Json::Value v = root["CompressedReactor"][k];
-    for (Json::Value & coords : v) {
-      std::tuple<BlockType, CoolerType> & blockInfo = stringToBlockType[k];
-      out->setCell(
-        coords["X"].asInt() - 1, coords["Y"].asInt() - 1, coords["Z"].asInt() - 1,
-        std::get<BlockType>(blockInfo), std::get<CoolerType>(blockInfo)
-      );
+    for (std::string & k : root["CompressedReactor"].getMemberNames()) {
+      auto blockInfo = stringToBlockType.find(k);
+      if (blockInfo == stringToBlockType.end()) {
+        fprintf(stderr, "%s: unknown block %s\n", fn.c_str(), k.c_str());
+        continue;
+      }
+      Json::Value v = root["CompressedReactor"][k];
+      for (Json::Value & coords : v) {
+        out->setCell(
+          coords["X"].asInt() - 1, coords["Y"].asInt() - 1, coords["Z"].asInt() - 1,
+          std::get<BlockType>(blockInfo->second), std::get<CoolerType>(blockInfo->second)
+        );
+      }
     }
   }
+  catch (const std::exception & e) {
+    fprintf(stderr, "%s: %s\n", fn.c_str(), e.what());
+    delete out;
+    return nullptr;
+  }
 
   return out;
 }
@@ -412,30 +458,137 @@ const std::string & fuelNameForFuelType(FuelType f) {
   return fuel_names[static_cast<int>(f)];
 }
 
-Reactor::Reactor(index_t x, index_t y, index_t z) {
-  _blocks = std::vector<BlockType>(x * y * z, BlockType::air);
-  _coolerTypes = std::vector<CoolerType>(x * y * z, CoolerType::air);
-  _cellActiveCache = std::vector<int>(x * y * z, 0);
+bool fuelTypeForName(const std::string & name, FuelType & out) {
+  for (int f = 0; f < static_cast<int>(FuelType::FUEL_TYPE_MAX); f++) {
+    if (fuel_names[f] == name) {
+      out = static_cast<FuelType>(f);
+      return true;
+    }
+  }
+
+  char * end;
+  long f = strtol(name.c_str(), &end, 10);
+  if (name.empty() || *end || f < 0 || f >= static_cast<long>(FuelType::FUEL_TYPE_MAX)) {
+    return false;
+  }
+  out = static_cast<FuelType>(f);
+  return true;
+}
 
+float fuelPowerForFuelType(FuelType f) {
+  return fuel_power[static_cast<int>(f)];
+}
+
+float fuelHeatForFuelType(FuelType f) {
+  return fuel_heat[static_cast<int>(f)];
+}
+
+float coolerStrengthForCoolerType(CoolerType ct) {
+  return coolerStrengths[ct];
+}
+
+float maxSuggestedCoolerStrength() {
+  float ret = 0;
+  for (CoolerType ct : suggestedCoolerWhitelist) {
+    ret = std::max(ret, coolerStrengths[ct]);
+  }
+  return ret;
+}
+
+Reactor::Reactor(index_t x, index_t y, index_t z) {
   _x = x;
   _y = y;
   _z = z;
 
+  _blocks = std::vector<BlockType>(volume(), BlockType::air);
+  _coolerTypes = std::vector<CoolerType>(volume(), CoolerType::air);
+  _cellActiveCache = std::vector<int8_t>(volume(), 0);
+
+  _hash = 0;
+  _occupied = 0;
   _dirty = true;
+  _approximate = false;
+  _cachesValid = false;
+  _outsideAirValid = false;
+  _filledOverflow = false;
+  _cachedCellsOverflow = false;
 
   offsets = {
     1,
     -1,
     _z,
     -_z,
-    _y * _z,
-    -_y * _z
+    (vector_offset_t)_y * _z,
+    -(vector_offset_t)_y * _z
   };
 }
 
+bool Reactor::validDimensions(long x, long y, long z) {
+  return x >= 1 && y >= 1 && z >= 1
+      && x <= MAX_REACTOR_DIMENSION && y <= MAX_REACTOR_DIMENSION && z <= MAX_REACTOR_DIMENSION
+      && x * y * z <= MAX_REACTOR_VOLUME;
+}
+
+size_t Reactor::evaluatedBytes(largecount_t volume) {
+  size_t perCell = sizeof(BlockType) + sizeof(CoolerType)
+    + 2 * sizeof(int8_t)        // activity caches
+    + sizeof(int32_t)           // in at most one of the cell lists
+    + 4 * sizeof(float) + sizeof(char) // contribution map
+    + sizeof(uint8_t);          // _outsideAir
+  // _filled and _cachedCells
+  size_t sparse = 2 * sizeof(int32_t) * (volume / SPARSE_EVALUATION_OCCUPANCY + 1);
+  return sizeof(Reactor) + perCell * volume + sparse;
+}
+
 Reactor::~Reactor() {
 }
 
+largecount_t Reactor::applyCells(std::span<const CellChange> changes, std::vector<coord_t> & changed) {
+  // (cell, position in the batch) of every edit in bounds; sorted, the
+  // edits to one cell are adjacent and in batch order
+  static thread_local std::vector<std::pair<vector_offset_t, uint32_t> > touched;
+  touched.clear();
+  for (uint32_t i = 0; i < changes.size(); i++) {
+    const CellChange & c = changes[i];
+    if (isInBounds(c.x, c.y, c.z)) {
+      touched.push_back({_offset(c.x, c.y, c.z), i});
+    }
+  }
+  std::sort(touched.begin(), touched.end());
+
+  largecount_t ret = 0;
+  for (size_t i = 0; i < touched.size(); i++) {
+    vector_offset_t n = touched[i].first;
+    if (i + 1 < touched.size() && touched[i + 1].first == n) {
+      continue;
+    }
+
+    const CellChange & c = changes[touched[i].second];
+    CoolerType ct = c.block == BlockType::cooler ? c.cooler : CoolerType::air;
+    if (_blocks[n] == c.block && _coolerTypes[n] == ct) {
+      continue;
+    }
+
+    _hash ^= _zobrist(n, cellCode(n));
+    if (c.block != BlockType::air && _blocks[n] == BlockType::air) {
+      _noteFilled(n);
+    }
+    _occupied += (c.block != BlockType::air) - (_blocks[n] != BlockType::air);
+    _blocks[n] = c.block;
+    _coolerTypes[n] = ct;
+    _hash ^= _zobrist(n, cellCode(n));
+
+    changed.push_back({c.x, c.y, c.z});
+    ret++;
+  }
+
+  if (ret) {
+    _dirty = true;
+    _outsideAirValid = false;
+  }
+  return ret;
+}
+
 bool Reactor::coolerTypeActiveAt(index_t x, index_t y, index_t z, CoolerType ct) {
   switch(ct)
   {
@@ -489,82 +642,112 @@ bool Reactor::coolerTypeActiveAt(index_t x, index_t y, index_t z, CoolerType ct)
 }
 
 bool Reactor::_hasPathToOutside(index_t x, index_t y, index_t z) {
-  std::set<coord_t> visited;
-
-  visited.insert({x, y, z});
-
-  if (_hasPathToOutside_initStep(x-1, y, z, visited)
-  || _hasPathToOutside_initStep(x+1, y, z, visited)
-  || _hasPathToOutside_initStep(x, y-1, z, visited)
-  || _hasPathToOutside_initStep(x, y+1, z, visited)
-  || _hasPathToOutside_initStep(x, y, z-1, visited)
-  || _hasPathToOutside_initStep(x, y, z+1, visited)) {
+  if (_approximate) {
+    // the approximate scorer doesn't check active cooler connectivity
     return true;
   }
 
-  return false;
-}
+  if (!_outsideAirValid) {
+    _fillOutsideAir();
+  }
 
-bool Reactor::_hasPathToOutside_initStep(index_t x, index_t y, index_t z, std::set<coord_t> & visited) {
-  visited.insert({x, y, z});
+  const index_t around[6][3] = {
+    {x-1, y, z}, {x+1, y, z}, {x, y-1, z}, {x, y+1, z}, {x, y, z-1}, {x, y, z+1}
+  };
 
+  // a cooler blocks the way; there an air neighbour connected to the
+  // casing is all it takes
   if (blockTypeAt(x, y, z) != BlockType::air) {
+    for (const auto & c : around) {
+      if (isInBounds(c[0], c[1], c[2]) && _outsideAir[_offset(c[0], c[1], c[2])]) {
+        return true;
+      }
+    }
     return false;
   }
 
-  if (!visited.count({x-1, y, z}) && _hasPathToOutside_followStep(x-1, y, z, visited)) {
-    return true;
+  // (asked about a cooler that isn't placed yet.) an air cell isn't a way
+  // out, so flood the neighbours' air with it walled off. nothing to do if
+  // its air doesn't reach the casing at all
+  if (!_outsideAir[_offset(x, y, z)]) {
+    return false;
   }
-  if (!visited.count({x+1, y, z}) && _hasPathToOutside_followStep(x+1, y, z, visited)) {
-    return true;
+
+  static thread_local std::vector<uint32_t> seen;
+  static thread_local uint32_t stamp = 0;
+  static thread_local std::vector<vector_offset_t> stack;
+  if (seen.size() < (size_t)volume()) {
+    seen.assign(volume(), 0);
+    stamp = 0;
   }
-  if (!visited.count({x, y-1, z}) && _hasPathToOutside_followStep(x, y-1, z, visited)) {
-    return true;
+  if (++stamp == 0) {
+    std::fill(seen.begin(), seen.end(), 0);
+    stamp = 1;
   }
-  if (!visited.count({x, y+1, z}) && _hasPathToOutside_followStep(x, y+1, z, visited)) {
-    return true;
-  }
-  if (!visited.count({x, y, z-1}) && _hasPathToOutside_followStep(x, y, z-1, visited)) {
-    return true;
+
+  stack.clear();
+  seen[_offset(x, y, z)] = stamp;
+  for (const auto & c : around) {
+    if (blockTypeAt(c[0], c[1], c[2]) == BlockType::air) {
+      seen[_offset(c[0], c[1], c[2])] = stamp;
+      stack.push_back(_offset(c[0], c[1], c[2]));
+    }
   }
-  if (!visited.count({x, y, z+1}) && _hasPathToOutside_followStep(x, y, z+1, visited)) {
-    return true;
+
+  while (!stack.empty()) {
+    coord_t c = coordinatesOf(stack.back());
+    stack.pop_back();
+    for (int d = 0; d < 6; d++) {
+      index_t nx = c[0] + (d == 0) - (d == 1);
+      index_t ny = c[1] + (d == 2) - (d == 3);
+      index_t nz = c[2] + (d == 4) - (d == 5);
+      BlockType bt = blockTypeAt(nx, ny, nz);
+      if (bt == BlockType::casing) {
+        return true;
+      }
+      vector_offset_t n = _offset(nx, ny, nz);
+      if (bt == BlockType::air && seen[n] != stamp) {
+        seen[n] = stamp;
+        stack.push_back(n);
+      }
+    }
   }
 
   return false;
 }
 
-bool Reactor::_hasPathToOutside_followStep(index_t x, index_t y, index_t z, std::set<coord_t> & visited) {
-  visited.insert({x, y, z});
-
-  if (blockTypeAt(x, y, z) == BlockType::casing) {
-    return true;
-  }
-
-  if (blockTypeAt(x, y, z) != BlockType::air) {
-    return false;
+void Reactor::_fillOutsideAir() {
+  // flood the air inwards from every air cell touching the casing
+  static thread_local std::vector<vector_offset_t> stack;
+  stack.clear();
+  _outsideAir.assign(volume(), 0);
+
+  for (index_t x = 0; x < _x; x++) {
+    for (index_t y = 0; y < _y; y++) {
+      for (index_t z = 0; z < _z; z++) {
+        if (blockTypeAt(x, y, z) == BlockType::air && reactorCasingsAdjacentTo(x, y, z)) {
+          _outsideAir[_offset(x, y, z)] = 1;
+          stack.push_back(_offset(x, y, z));
+        }
+      }
+    }
   }
 
-  if (!visited.count({x-1, y, z}) && _hasPathToOutside_followStep(x-1, y, z, visited)) {
-    return true;
-  }
-  if (!visited.count({x+1, y, z}) && _hasPathToOutside_followStep(x+1, y, z, visited)) {
-    return true;
-  }
-  if (!visited.count({x, y-1, z}) && _hasPathToOutside_followStep(x, y-1, z, visited)) {
-    return true;
-  }
-  if (!visited.count({x, y+1, z}) && _hasPathToOutside_followStep(x, y+1, z, visited)) {
-    return true;
-  }
-  if (!visited.count({x, y, z-1}) && _hasPathToOutside_followStep(x, y, z-1, visited)) {
-    return true;
-  }
-  if (!visited.count({x, y, z+1}) && _hasPathToOutside_followStep(x, y, z+1, visited)) {
-    return true;
+  while (!stack.empty()) {
+    coord_t c = coordinatesOf(stack.back());
+    stack.pop_back();
+    for (int d = 0; d < 6; d++) {
+      index_t nx = c[0] + (d == 0) - (d == 1);
+      index_t ny = c[1] + (d == 2) - (d == 3);
+      index_t nz = c[2] + (d == 4) - (d == 5);
+      if (blockTypeAt(nx, ny, nz) == BlockType::air && !_outsideAir[_offset(nx, ny, nz)]) {
+        _outsideAir[_offset(nx, ny, nz)] = 1;
+        stack.push_back(_offset(nx, ny, nz));
+      }
+    }
   }
 
-  return false;
+  _outsideAirValid = true;
 }
 
 smallcount_t Reactor::_blockTypeAdjacentTo(index_t x, index_t y, index_t z, BlockType bt) {
@@ -654,11 +837,11 @@ smallcount_t Reactor::activeModeratorsAdjacentTo(index_t x, index_t y, index_t z
   smallcount_t ret = 0;
 
   // if (_dirty) {
-  //   _cellModeratorAdjacencyCache = std::vector<int>(_x * _y * _z, -1);
+  //   _cellModeratorAdjacencyCache = std::vector<int>(volume(), -1);
   // }
 
-  if (_cellModeratorAdjacencyCache[x * (_y * _z) + y * (_z) + z] != -1) {
-    return _cellModeratorAdjacencyCache[x * (_y * _z) + y * (_z) + z];
+  if (_cellModeratorAdjacencyCache[_offset(x, y, z)] != -1) {
+    return _cellModeratorAdjacencyCache[_offset(x, y, z)];
   }
 
   if (blockTypeAt(x-1, y, z) == BlockType::moderator && moderatorActiveAt(x-1, y, z)) ret++;
@@ -668,7 +851,8 @@ smallcount_t Reactor::activeModeratorsAdjacentTo(index_t x, index_t y, index_t z
   if (blockTypeAt(x, y, z-1) == BlockType::moderator && moderatorActiveAt(x, y, z-1)) ret++;
   if (blockTypeAt(x, y, z+1) == BlockType::moderator && moderatorActiveAt(x, y, z+1)) ret++;
 
-  _cellModeratorAdjacencyCache[x * (_y * _z) + y * (_z) + z] = ret;
+  _cellModeratorAdjacencyCache[_offset(x, y, z)] = ret;
+  _noteCached(_offset(x, y, z));
 
   return ret;
 }
@@ -676,121 +860,525 @@ smallcount_t Reactor::activeModeratorsAdjacentTo(index_t x, index_t y, index_t z
 smallcount_t Reactor::activeCoolersAdjacentTo(index_t x, index_t y, index_t z, CoolerType ct) {
   smallcount_t ret = 0;
 
-  if (coolerTypeAt(x-1, y, z) == ct && coolerActiveAt(x-1, y, z)) ret++;
-  if (coolerTypeAt(x+1, y, z) == ct && coolerActiveAt(x+1, y, z)) ret++;
-  if (coolerTypeAt(x, y-1, z) == ct && coolerActiveAt(x, y-1, z)) ret++;
-  if (coolerTypeAt(x, y+1, z) == ct && coolerActiveAt(x, y+1, z)) ret++;
-  if (coolerTypeAt(x, y, z-1) == ct && coolerActiveAt(x, y, z-1)) ret++;
-  if (coolerTypeAt(x, y, z+1) == ct && coolerActiveAt(x, y, z+1)) ret++;
+  // CoolerType::air matches any cooler (but not air / out of bounds)
+  auto matches = [&](index_t x, index_t y, index_t z) {
+    CoolerType at = coolerTypeAt(x, y, z);
+    return (ct == CoolerType::air ? at != CoolerType::air : at == ct) && coolerActiveAt(x, y, z);
+  };
+
+  if (matches(x-1, y, z)) ret++;
+  if (matches(x+1, y, z)) ret++;
+  if (matches(x, y-1, z)) ret++;
+  if (matches(x, y+1, z)) ret++;
+  if (matches(x, y, z-1)) ret++;
+  if (matches(x, y, z+1)) ret++;
+
+  return ret;
+}
 
+static float maxCoolerStrength() {
+  float ret = 0;
+  for (const auto & cs : coolerStrengths) {
+    ret = std::max(ret, cs.second);
+  }
+  return ret;
+}
+
+Reactor::CellContribution Reactor::_cellContribution(index_t x, index_t y, index_t z) {
+  CellContribution ret = { 0, 0, 0, false, MUTATION_WEIGHT_BASE };
+
+  BlockType bt = blockTypeAt(x, y, z);
+
+  if (bt == BlockType::reactorCell) {
+    smallcount_t adjCellCt = reactorCellsAdjacentTo(x, y, z);
+    smallcount_t adjModCt = activeModeratorsAdjacentTo(x, y, z);
+
+    ret.power = (1 + adjCellCt) + (1 + adjCellCt) * (adjModCt / 6.0);
+    ret.heat = (adjCellCt + 1) * (adjCellCt + 2) / 2.0 + (1 + adjCellCt) * (adjModCt / 3.0);
+
+    // best case is 6 adjacent cells and 6 active moderators
+    ret.mutationWeight += MUTATION_WEIGHT_WEAK * (1 - ret.power / 14);
+  }
+  else if (bt == BlockType::cooler) {
+    if (coolerActiveAt(x, y, z)) {
+      static const float strongest = maxCoolerStrength();
+      ret.cooling = coolerStrengths[coolerTypeAt(x, y, z)];
+      ret.mutationWeight += MUTATION_WEIGHT_WEAK * (1 - ret.cooling / strongest);
+    }
+    else {
+      ret.wasted = true;
+      ret.mutationWeight = MUTATION_WEIGHT_WASTED;
+    }
+  }
+  else if (bt == BlockType::moderator) {
+    smallcount_t adjCellCt = reactorCellsAdjacentTo(x, y, z);
+    if (!adjCellCt) {
+      ret.heat = 1;
+      ret.wasted = true;
+      ret.mutationWeight = MUTATION_WEIGHT_WASTED;
+    }
+    else {
+      // a moderator between two cells is pulling its weight
+      ret.mutationWeight += MUTATION_WEIGHT_WEAK * std::max(0, 2 - adjCellCt) / 2;
+    }
+  }
+
+  return ret;
+}
+
+void Reactor::_storeContribution(vector_offset_t n, const CellContribution & cc) {
+  _cellPower[n] = cc.power * fuel_power[static_cast<int>(FuelType::generic)];
+  _cellHeat[n] = cc.heat * fuel_heat[static_cast<int>(FuelType::generic)];
+  _cellCooling[n] = cc.cooling;
+  _cellWasted[n] = cc.wasted;
+  _cellMutationWeight[n] = cc.mutationWeight;
+}
+
+/** A set of cells of one reactor: a list in insertion order plus a mark per
+  * cell. Repair and approximate evaluation keep thread-local ones, which
+  * stop allocating once they have grown to the reactor's size.
+  */
+struct Reactor::CellSet {
+  std::vector<coord_t> cells;
+  std::vector<char> marked;
+  int yz = 0, zs = 0;
+
+  /** Empty the set and size it for an x * y * z reactor. */
+  void reset(int x, int y, int z) {
+    for (const coord_t & c : cells) {
+      marked[c[0] * yz + c[1] * zs + c[2]] = 0;
+    }
+    cells.clear();
+    yz = y * z;
+    zs = z;
+    if (marked.size() < (size_t)x * y * z) {
+      marked.assign((size_t)x * y * z, 0);
+    }
+  }
+
+  /** @return whether `c` (in bounds) wasn't in the set yet */
+  inline bool insert(const coord_t & c) {
+    char & m = marked[c[0] * yz + c[1] * zs + c[2]];
+    if (m) {
+      return false;
+    }
+    m = 1;
+    cells.push_back(c);
+    return true;
+  }
+
+  /** Sort the list (into storage order), as iterating a std::set would. */
+  inline void sort() {
+    std::sort(cells.begin(), cells.end());
+  }
+};
+
+void Reactor::evaluateApproximate(const std::vector<coord_t> & changed) {
+  if (!_dirty) {
+    return;
+  }
+  if (!_cachesValid) {
+    _evaluate();
+    return;
+  }
+
+  // cells whose contribution can see the change: anything within two steps
+  // (cooler / moderator activity) plus the lines a cell looks down through
+  // moderators
+  static thread_local CellSet region;
+  region.reset(_x, _y, _z);
+  for (const coord_t & c : changed) {
+    _cellsDependingOn(c, region);
+    for (int i = 3; i <= 5; i++) {
+      for (const coord_t & n : std::initializer_list<coord_t> {
+        {static_cast<index_t>(c[0] - i), c[1], c[2]}, {static_cast<index_t>(c[0] + i), c[1], c[2]},
+        {c[0], static_cast<index_t>(c[1] - i), c[2]}, {c[0], static_cast<index_t>(c[1] + i), c[2]},
+        {c[0], c[1], static_cast<index_t>(c[2] - i)}, {c[0], c[1], static_cast<index_t>(c[2] + i)},
+      }) {
+        if (isInBounds(UNPACK(n))) {
+          region.insert(n);
+        }
+      }
+    }
+  }
+  region.sort();
+
+  // everything outside the region keeps the cached state of the reactor
+  // this was copied from
+  for (const coord_t & c : region.cells) {
+    _cellActiveCache[_offset(c[0], c[1], c[2])] = 0;
+    _cellModeratorAdjacencyCache[_offset(c[0], c[1], c[2])] = -1;
+  }
+
+  float genericPower = _powerGeneratedCache[FuelType::generic];
+  float genericHeat = _heatGeneratedCache[FuelType::generic];
+  float totalCooling = _heatGeneratedCache[FuelType::air];
+
+  _dirty = false;
+  _approximate = true;
+  _cachesValid = false;
+
+  for (const coord_t & c : region.cells) {
+    vector_offset_t n = _offset(c[0], c[1], c[2]);
+
+    genericPower -= _cellPower[n];
+    genericHeat -= _cellHeat[n];
+    totalCooling += _cellCooling[n];
+    _inactiveBlocks -= _cellWasted[n];
+
+    CellContribution cc = _cellContribution(UNPACK(c));
+    _storeContribution(n, cc);
+
+    genericPower += _cellPower[n];
+    genericHeat += _cellHeat[n];
+    totalCooling -= _cellCooling[n];
+    _inactiveBlocks += _cellWasted[n];
+  }
+
+  _powerGeneratedCache.clear();
+  _heatGeneratedCache.clear();
+  _powerGeneratedCache[FuelType::air] = 0;
+  _powerGeneratedCache[FuelType::generic] = genericPower;
+  _heatGeneratedCache[FuelType::air] = totalCooling;
+  _heatGeneratedCache[FuelType::generic] = genericHeat;
+}
+
+int Reactor::_mirrorAxes() {
+  auto same = [&](vector_offset_t n, vector_offset_t m) {
+    return _blocks[n] == _blocks[m] && _coolerTypes[n] == _coolerTypes[m];
+  };
+
+  // every cell in the lower half of an axis against its mirror image; most
+  // asymmetric reactors are given away by the first few cells
+  int ret = 7;
+  for (index_t x = 0; ret && x < _x; x++) {
+    index_t mx = _x - 1 - x;
+    for (index_t y = 0; ret && y < _y; y++) {
+      index_t my = _y - 1 - y;
+      for (index_t z = 0; ret && z < _z; z++) {
+        index_t mz = _z - 1 - z;
+        vector_offset_t n = _offset(x, y, z);
+        if ((ret & 1) && x < mx && !same(n, _offset(mx, y, z))) ret &= ~1;
+        if ((ret & 2) && y < my && !same(n, _offset(x, my, z))) ret &= ~2;
+        if ((ret & 4) && z < mz && !same(n, _offset(x, y, mz))) ret &= ~4;
+      }
+    }
+  }
   return ret;
 }
 
 void Reactor::_evaluate(FuelType ft) {
   if (_dirty) {
+    // scoring just the blocks beats scoring an octant of every cell below
+    // about 1 / 6 full, so a mostly empty reactor isn't checked for mirrors
+    bool sparse = _occupied * SPARSE_EVALUATION_OCCUPANCY <= volume();
+    int mirrors = 0;
+#ifdef SYMMETRIC_EVALUATION
+    if (!sparse) {
+      mirrors = _mirrorAxes();
+    }
+#endif
+
+    if (sparse) {
+      _evaluateSparse();
+    }
+    else {
+      _evaluateCells(mirrors);
+    }
+
+#if defined(VERIFY_SYMMETRIC_EVALUATION) || defined(VERIFY_SPARSE_EVALUATION)
+    bool verify = false;
+#ifdef VERIFY_SYMMETRIC_EVALUATION
+    verify |= mirrors != 0;
+#endif
+#ifdef VERIFY_SPARSE_EVALUATION
+    verify |= sparse;
+#endif
+    if (verify) {
+      Reactor check(*this);
+      check._evaluateCells(0);
+      if (!_sameEvaluation(check)) {
+        fprintf(stderr, "%s evaluation (mirrors %d, %ld of %ld cells filled) differs from full evaluation:\n%s",
+          sparse ? "sparse" : "symmetric", mirrors, (long)_occupied, (long)volume(), describe().c_str());
+        abort();
+      }
+    }
+#endif
+  }
 
-    _powerGeneratedCache.clear();
-    _heatGeneratedCache.clear();
-    _cellActiveCache = std::vector<int>(_x * _y * _z, 0);
-    _cellModeratorAdjacencyCache = std::vector<int>(_x * _y * _z, -1);
-    _inactiveBlocks = 0;
+  if(!_powerGeneratedCache.count(ft))
+  {
+    _powerGeneratedCache[ft] = _powerGeneratedCache[FuelType::generic] * fuel_power[static_cast<int>(ft)];
+    _heatGeneratedCache[ft] = _heatGeneratedCache[FuelType::generic] * fuel_heat[static_cast<int>(ft)] + _heatGeneratedCache[FuelType::air];
+  }
+}
 
-    _reactorCellCache.clear();
-    _moderatorCache.clear();
-    _coolerCache.clear();
+bool Reactor::_sameEvaluation(const Reactor & b) const {
+  auto close = [](float a, float b) {
+    return std::fabs(a - b) <= 1e-4f * std::max(1.0f, std::max(std::fabs(a), std::fabs(b)));
+  };
+  bool ok = b._inactiveBlocks == _inactiveBlocks
+    && close(b._powerGeneratedCache.value[static_cast<int>(FuelType::generic)], _powerGeneratedCache.value[static_cast<int>(FuelType::generic)])
+    && close(b._heatGeneratedCache.value[static_cast<int>(FuelType::generic)], _heatGeneratedCache.value[static_cast<int>(FuelType::generic)])
+    && close(b._heatGeneratedCache.value[static_cast<int>(FuelType::air)], _heatGeneratedCache.value[static_cast<int>(FuelType::air)]);
+  for (vector_offset_t n = 0; ok && n < volume(); n++) {
+    ok = b._cellPower[n] == _cellPower[n] && b._cellHeat[n] == _cellHeat[n]
+      && b._cellCooling[n] == _cellCooling[n] && b._cellWasted[n] == _cellWasted[n]
+      && b._cellMutationWeight[n] == _cellMutationWeight[n];
+  }
+  return ok;
+}
 
-    for(index_t x = 0; x < _x; x++)
+void Reactor::_evaluateCells(int mirrors) {
+  _powerGeneratedCache.clear();
+  _heatGeneratedCache.clear();
+  _cellActiveCache.assign(volume(), 0);
+  _cellModeratorAdjacencyCache.assign(volume(), -1);
+  _inactiveBlocks = 0;
+
+  _reactorCellCache.clear();
+  _moderatorCache.clear();
+  _coolerCache.clear();
+
+  _cellPower.assign(volume(), 0);
+  _cellHeat.assign(volume(), 0);
+  _cellCooling.assign(volume(), 0);
+  _cellWasted.assign(volume(), 0);
+  _cellMutationWeight.assign(volume(), MUTATION_WEIGHT_BASE);
+
+  for(index_t x = 0; x < _x; x++)
+  {
+    for(index_t y = 0; y < _y; y++)
     {
-      for(index_t y = 0; y < _y; y++)
+      for(index_t z = 0; z < _z; z++)
       {
-        for(index_t z = 0; z < _z; z++)
+        switch(blockTypeAt(x, y, z))
         {
-          switch(blockTypeAt(x, y, z))
-          {
-            case BlockType::reactorCell:
-              _reactorCellCache.push_back(_XYZ(x, y, z));
-              break;
-            case BlockType::moderator:
-              _moderatorCache.push_back(_XYZ(x, y, z));
-              break;
-            case BlockType::cooler:
-              _coolerCache.push_back(_XYZ(x, y, z));
-              break;
-          }
+          case BlockType::reactorCell:
+            _reactorCellCache.push_back(_offset(x, y, z));
+            break;
+          case BlockType::moderator:
+            _moderatorCache.push_back(_offset(x, y, z));
+            break;
+          case BlockType::cooler:
+            _coolerCache.push_back(_offset(x, y, z));
+            break;
         }
       }
     }
+  }
 
-    _dirty = false;
-
-    float totalCooling = 0, genericPower = 0, genericHeat = 0;
-
-    //#pragma omp parallel for
-    for (index_t x = 0; x < _x; x++) {
-      for (index_t y = 0; y < _y; y++) {
-        for (index_t z = 0; z < _z; z++) {
-
-          BlockType bt = blockTypeAt(x, y, z);
+  _dirty = false;
+  _approximate = false;
+
+  float totalCooling = 0, genericPower = 0, genericHeat = 0;
+
+  // in an axis the blocks are mirrored in, only the lower half (with the
+  // mid-plane, if there is one) is scored; a cell off the mid-plane stands
+  // for itself and its mirror image
+  const index_t hx = mirrors & 1 ? (_x + 1) / 2 : _x;
+  const index_t hy = mirrors & 2 ? (_y + 1) / 2 : _y;
+  const index_t hz = mirrors & 4 ? (_z + 1) / 2 : _z;
+
+  //#pragma omp parallel for
+  for (index_t x = 0; x < hx; x++) {
+    for (index_t y = 0; y < hy; y++) {
+      for (index_t z = 0; z < hz; z++) {
+        CellContribution cc = _cellContribution(x, y, z);
+
+        index_t xs[2] = { x, static_cast<index_t>(_x - 1 - x) };
+        index_t ys[2] = { y, static_cast<index_t>(_y - 1 - y) };
+        index_t zs[2] = { z, static_cast<index_t>(_z - 1 - z) };
+        int nx = (mirrors & 1) && xs[1] != x ? 2 : 1;
+        int ny = (mirrors & 2) && ys[1] != y ? 2 : 1;
+        int nz = (mirrors & 4) && zs[1] != z ? 2 : 1;
+        int images = nx * ny * nz;
+
+        //#pragma omp atomic
+        genericPower += images * cc.power;
+        //#pragma omp atomic
+        genericHeat += images * cc.heat;
+        //#pragma omp atomic
+        totalCooling -= images * cc.cooling;
+
+        if (cc.wasted) {
+          _inactiveBlocks += images;
+        }
 
-          if (bt == BlockType::reactorCell) {
-            smallcount_t adjCellCt = reactorCellsAdjacentTo(x, y, z);
-            smallcount_t adjModCt = activeModeratorsAdjacentTo(x, y, z);
+        vector_offset_t n = _offset(x, y, z);
+        _storeContribution(n, cc);
 
-            //#pragma omp atomic
-            genericPower += (1 + adjCellCt) + (1 + adjCellCt) * (adjModCt / 6.0);
-            //#pragma omp atomic
-            genericHeat += (adjCellCt + 1) * (adjCellCt + 2) / 2.0 + (1 + adjCellCt) * (adjModCt / 3.0);
-          }
-          else if (bt == BlockType::cooler) {
-            //#pragma omp atomic
-            if (coolerActiveAt(x, y, z)) {
-              totalCooling -= coolerStrengths[coolerTypeAt(x, y, z)];
-            }
-            else {
-              _inactiveBlocks += 1;
-            }
-          }
-          else if (bt == BlockType::moderator) {
-            if (!reactorCellsAdjacentTo(x, y, z)) {
-              //#pragma omp atomic
-              genericHeat += 1;
-              _inactiveBlocks += 1;
+        for (int i = 0; i < nx; i++) {
+          for (int j = 0; j < ny; j++) {
+            for (int k = i || j ? 0 : 1; k < nz; k++) {
+              vector_offset_t m = _offset(xs[i], ys[j], zs[k]);
+              _storeContribution(m, cc);
+              _cellActiveCache[m] = _cellActiveCache[n];
+              _cellModeratorAdjacencyCache[m] = _cellModeratorAdjacencyCache[n];
             }
           }
         }
       }
     }
+  }
 
-    _powerGeneratedCache[FuelType::air] = 0;
-    _powerGeneratedCache[FuelType::generic] = genericPower * fuel_power[static_cast<int>(FuelType::generic)];
-    _heatGeneratedCache[FuelType::air] = totalCooling;
-    _heatGeneratedCache[FuelType::generic] = genericHeat * fuel_heat[static_cast<int>(FuelType::generic)];
+  _powerGeneratedCache[FuelType::air] = 0;
+  _powerGeneratedCache[FuelType::generic] = genericPower * fuel_power[static_cast<int>(FuelType::generic)];
+  _heatGeneratedCache[FuelType::air] = totalCooling;
+  _heatGeneratedCache[FuelType::generic] = genericHeat * fuel_heat[static_cast<int>(FuelType::generic)];
+
+  _cachesValid = true;
+  // the lists are complete again; the caches were filled all over
+  _filled.clear();
+  _filledOverflow = false;
+  _cachedCells.clear();
+  _cachedCellsOverflow = true;
+}
 
+void Reactor::_evaluateSparse() {
+  _powerGeneratedCache.clear();
+  _heatGeneratedCache.clear();
+  _resetActivityCaches();
+  _inactiveBlocks = 0;
+
+  // the cells that may hold a block, in storage order (the order the full
+  // evaluation adds them up in): the previous evaluation's blocks and the
+  // cells filled since. Every contribution the previous evaluation (exact
+  // or approximate) left is at one of them
+  static thread_local std::vector<int32_t> cells;
+  cells.clear();
+  static const CellContribution none = { 0, 0, 0, false, MUTATION_WEIGHT_BASE };
+  if (!_filledOverflow && _cellPower.size() == (size_t)volume()) {
+    for (const std::vector<int32_t> * list : { &_reactorCellCache, &_moderatorCache, &_coolerCache, &_filled }) {
+      cells.insert(cells.end(), list->begin(), list->end());
+    }
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+    for (vector_offset_t n : cells) {
+      _storeContribution(n, none);
+    }
+  }
+  else {
+    _cellPower.assign(volume(), 0);
+    _cellHeat.assign(volume(), 0);
+    _cellCooling.assign(volume(), 0);
+    _cellWasted.assign(volume(), 0);
+    _cellMutationWeight.assign(volume(), MUTATION_WEIGHT_BASE);
+
+    // no telling where the blocks are: find them eight cells at a time
+    static_assert(sizeof(BlockType) == 1 && static_cast<int>(BlockType::air) == 0, "eight block types to a word, air is 0");
+    static_assert(std::endian::native == std::endian::little, "cell n + i is byte i of a word");
+    const largecount_t volume = this->volume();
+    for (vector_offset_t base = 0; base < volume; base += 8) {
+      uint64_t word = 0;
+      memcpy(&word, &_blocks[base], std::min<largecount_t>(8, volume - base));
+      while (word) {
+        int byte = std::countr_zero(word) / 8;
+        word &= ~(0xffULL << (8 * byte));
+        cells.push_back(base + byte);
+      }
+    }
   }
 
-  if(!_powerGeneratedCache.count(ft))
-  {
-    _powerGeneratedCache[ft] = _powerGeneratedCache[FuelType::generic] * fuel_power[static_cast<int>(ft)];
-    _heatGeneratedCache[ft] = _heatGeneratedCache[FuelType::generic] * fuel_heat[static_cast<int>(ft)] + _heatGeneratedCache[FuelType::air];
+  _reactorCellCache.clear();
+  _moderatorCache.clear();
+  _coolerCache.clear();
+  _filled.clear();
+  _filledOverflow = false;
+
+  _dirty = false;
+  _approximate = false;
+
+  float totalCooling = 0, genericPower = 0, genericHeat = 0;
+
+  for (vector_offset_t n : cells) {
+    switch (_blocks[n]) {
+      case BlockType::reactorCell:
+        _reactorCellCache.push_back(n);
+        break;
+      case BlockType::moderator:
+        _moderatorCache.push_back(n);
+        break;
+      case BlockType::cooler:
+        _coolerCache.push_back(n);
+        break;
+      default:
+        // emptied since
+        continue;
+    }
+
+    CellContribution cc = _cellContribution(UNPACK(coordinatesOf(n)));
+    genericPower += cc.power;
+    genericHeat += cc.heat;
+    totalCooling -= cc.cooling;
+    if (cc.wasted) {
+      _inactiveBlocks++;
+    }
+    _storeContribution(n, cc);
   }
+
+  _powerGeneratedCache[FuelType::air] = 0;
+  _powerGeneratedCache[FuelType::generic] = genericPower * fuel_power[static_cast<int>(FuelType::generic)];
+  _heatGeneratedCache[FuelType::air] = totalCooling;
+  _heatGeneratedCache[FuelType::generic] = genericHeat * fuel_heat[static_cast<int>(FuelType::generic)];
+
+  _cachesValid = true;
 }
 
-std::set<coord_t> Reactor::suggestPrincipledLocations()
+void Reactor::_resetActivityCaches() {
+  if (_cachedCellsOverflow || _cellActiveCache.size() != (size_t)volume() || _cellModeratorAdjacencyCache.size() != (size_t)volume()) {
+    _cellActiveCache.assign(volume(), 0);
+    _cellModeratorAdjacencyCache.assign(volume(), -1);
+  }
+  else {
+    for (vector_offset_t n : _cachedCells) {
+      _cellActiveCache[n] = 0;
+      _cellModeratorAdjacencyCache[n] = -1;
+    }
+  }
+  _cachedCells.clear();
+  _cachedCellsOverflow = false;
+}
+
+void Reactor::fuelTotals(const FuelType * fuels, int n, float * power, float * heat, float * effective) {
+  _evaluate();
+  const float genericPower = _powerGeneratedCache[FuelType::generic];
+  const float genericHeat = _heatGeneratedCache[FuelType::generic];
+  const float cooling = _heatGeneratedCache[FuelType::air];
+
+  // same arithmetic as powerGenerated / heatGenerated /
+  // effectivePowerGenerated, so the results match them exactly
+  #pragma omp simd
+  for (int i = 0; i < n; i++) {
+    int f = static_cast<int>(fuels[i]);
+    float p = f == static_cast<int>(FuelType::generic) ? genericPower : genericPower * fuel_power[f];
+    float h = f == static_cast<int>(FuelType::generic) ? genericHeat : genericHeat * fuel_heat[f] + cooling;
+    power[i] = p;
+    heat[i] = h;
+    effective[i] = h < 0 ? p : (cooling == 0 ? 0 : p * cooling / (cooling - h));
+  }
+}
+
+void Reactor::suggestPrincipledLocations(std::pmr::vector<coord_t> & ret)
 {
-  std::set<coord_t> ret;
+  ret.clear();
+  // (the caches below are only there once evaluated: a reactor fresh from a
+  // checkpoint or an archive would suggest nothing)
+  _evaluate();
+
+  const vector_offset_t v = volume();
 
   // cells collinear with existing reactor cells
-  for (const int & c : _reactorCellCache)
+  for (vector_offset_t c : _reactorCellCache)
   {
-    // fprintf(stderr, "%d %d %d %d\n", c, TO_XYZ(c));
-    ret.insert({TO_XYZ(c)});
-    for (const auto & o : offsets)
+    ret.push_back(coordinatesOf(c));
+    for (vector_offset_t o : offsets)
     {
-      int n = c + o;
+      vector_offset_t n = c + o;
       int i = 0;
-      while (i < 4 && n < (int_fast16_t)_x * (int_fast16_t)_y * (int_fast16_t)_z && n >= 0)
+      while (i < 4 && n < v && n >= 0)
       {
-        ret.insert({TO_XYZ(n)});
+        ret.push_back(coordinatesOf(n));
         n += o;
         ++i;
       }
@@ -798,41 +1386,38 @@ std::set<coord_t> Reactor::suggestPrincipledLocations()
   }
 
   // cells that are, or are adjacent to existing coolers
-  for (const auto & c : _coolerCache)
+  for (vector_offset_t c : _coolerCache)
   {
-    // fprintf(stderr, "%d %d %d %d\n", c, TO_XYZ(c));
-    ret.insert({TO_XYZ(c)});
-    for (const auto & o : offsets)
+    ret.push_back(coordinatesOf(c));
+    for (vector_offset_t o : offsets)
     {
-      if (c + o < (int_fast16_t)_x * (int_fast16_t)_y * (int_fast16_t)_z && c + o >= 0)
+      if (c + o < v && c + o >= 0)
       {
-        ret.insert({TO_XYZ(c + o)});
+        ret.push_back(coordinatesOf(c + o));
       }
     }
   }
 
   // cells adjacent to moderators that can support heatsinks
-  for (const auto & c : _moderatorCache)
+  for (vector_offset_t c : _moderatorCache)
   {
-    // fprintf(stderr, "%d %d %d %d\n", c, TO_XYZ(c));
-    if (moderatorActiveAt(TO_XYZ(c)))
+    if (moderatorActiveAt(UNPACK(coordinatesOf(c))))
     {
-      for (const auto & o : offsets)
+      for (vector_offset_t o : offsets)
       {
-        if (c + o < (int_fast16_t)_x * (int_fast16_t)_y * (int_fast16_t)_z && c + o >= 0)
+        if (c + o < v && c + o >= 0)
         {
-          ret.insert({TO_XYZ(c + o)});
+          ret.push_back(coordinatesOf(c + o));
         }
       }
     }
   }
 
-  return ret;
+  std::sort(ret.begin(), ret.end());
+  ret.erase(std::unique(ret.begin(), ret.end()), ret.end());
 }
 
-std::vector<std::tuple<BlockType, CoolerType, float> > Reactor::suggestedBlocksAt(index_t x, index_t y, index_t z, FuelType ft) {
-  std::vector<std::tuple<BlockType, CoolerType, float> > ret;
-
+void Reactor::suggestedBlocksAt(index_t x, index_t y, index_t z, FuelType ft, std::pmr::vector<suggestion_t> & ret) {
   ret.push_back(std::make_tuple(BlockType::air, CoolerType::air, 0.1));
 
   float heatFactor = 1;
@@ -855,20 +1440,105 @@ std::vector<std::tuple<BlockType, CoolerType, float> > Reactor::suggestedBlocksA
   for (int cti = 1; cti < static_cast<int>(CoolerType::COOLER_TYPE_MAX); cti++)
   {
     CoolerType ct = static_cast<CoolerType>(cti);
-    std::set<CoolerType> whitelist = {
-      CoolerType::redstone, CoolerType::gold, CoolerType::diamond,
-      CoolerType::iron, CoolerType::lapis, CoolerType::tin,
-      CoolerType::glowstone, CoolerType::quartz, CoolerType::copper, CoolerType::magnesium, 
-      CoolerType::cryotheum, CoolerType::enderium, CoolerType::liquidHelium,
-      // CoolerType::activeCryotheum,
-    };
-    if(whitelist.count(ct) > 0 && coolerTypeActiveAt(x, y, z, ct) && coolerTypeAt(x, y, z) != ct)
+    if(suggestedCoolerWhitelist.count(ct) > 0 && coolerTypeActiveAt(x, y, z, ct) && coolerTypeAt(x, y, z) != ct)
     {
       ret.push_back(std::make_tuple(BlockType::cooler, ct, 1));
     }
   }
+}
+
+void Reactor::_cellsDependingOn(const coord_t & c, CellSet & out) {
+  // a cooler's activity looks at its neighbours, and through
+  // activeModeratorsAdjacentTo at the neighbours of those; so anything within
+  // two steps of a change may flip
+  for (int dx = -2; dx <= 2; dx++) {
+    for (int dy = -2; dy <= 2; dy++) {
+      for (int dz = -2; dz <= 2; dz++) {
+        if (abs(dx) + abs(dy) + abs(dz) > 2) continue;
+        if (isInBounds(c[0] + dx, c[1] + dy, c[2] + dz)) {
+          out.insert({
+            static_cast<index_t>(c[0] + dx),
+            static_cast<index_t>(c[1] + dy),
+            static_cast<index_t>(c[2] + dz)
+          });
+        }
+      }
+    }
+  }
+}
 
-  return ret;
+largecount_t Reactor::repairInactive(Reactor & parent, const std::vector<coord_t> & changed, int maxRounds) {
+  largecount_t repaired = 0;
+
+  // (thread-local so that repairs don't allocate once warmed up)
+  static thread_local std::vector<coord_t> frontier, chain, broken;
+  static thread_local std::vector<CoolerType> replacements;
+  static thread_local CellSet region;
+  frontier.assign(changed.begin(), changed.end());
+
+  for (int round = 0; round < maxRounds && !frontier.empty(); round++) {
+    _evaluate();
+
+    region.reset(_x, _y, _z);
+    for (const coord_t & c : frontier) {
+      _cellsDependingOn(c, region);
+    }
+
+    // a cooler that switched on or off can in turn flip the coolers that
+    // depend on it (iron on gold on water...), so follow those chains
+    chain.assign(region.cells.begin(), region.cells.end());
+    while (!chain.empty()) {
+      coord_t c = chain.back();
+      chain.pop_back();
+
+      if (blockTypeAt(UNPACK(c)) != BlockType::cooler
+          || parent.blockTypeAt(UNPACK(c)) != BlockType::cooler
+          || parent.coolerTypeAt(UNPACK(c)) != coolerTypeAt(UNPACK(c))
+          || parent.wastedAt(UNPACK(c)) == wastedAt(UNPACK(c))) {
+        continue;
+      }
+
+      size_t known = region.cells.size();
+      _cellsDependingOn(c, region);
+      chain.insert(chain.end(), region.cells.begin() + known, region.cells.end());
+    }
+    region.sort();
+
+    broken.clear();
+    for (const coord_t & c : region.cells) {
+      if (!wastedAt(UNPACK(c))) continue;
+
+      bool wasWastedBefore = parent.blockTypeAt(UNPACK(c)) == blockTypeAt(UNPACK(c))
+                          && parent.coolerTypeAt(UNPACK(c)) == coolerTypeAt(UNPACK(c))
+                          && parent.wastedAt(UNPACK(c));
+      if (!wasWastedBefore) {
+        broken.push_back(c);
+      }
+    }
+
+    // decide every replacement against the same evaluated state, then apply
+    replacements.clear();
+    for (const coord_t & c : broken) {
+      CoolerType best = CoolerType::air;
+      if (blockTypeAt(UNPACK(c)) == BlockType::cooler) {
+        for (CoolerType ct : suggestedCoolerWhitelist) {
+          if (coolerStrengths[ct] > coolerStrengths[best] && coolerTypeActiveAt(UNPACK(c), ct)) {
+            best = ct;
+          }
+        }
+      }
+      replacements.push_back(best);
+    }
+
+    frontier.clear();
+    for (size_t i = 0; i < broken.size(); i++) {
+      setCell(UNPACK(broken[i]), replacements[i] == CoolerType::air ? BlockType::air : BlockType::cooler, replacements[i]);
+      frontier.push_back(broken[i]);
+      repaired++;
+    }
+  }
+
+  return repaired;
 }
 
 std::string Reactor::describe() {
@@ -895,7 +1565,7 @@ std::string Reactor::describe() {
   return r;
 }
 
-void Reactor::toJsonFile(std::string fn) {
+Json::Value Reactor::toJson() {
   Json::Value out;
   out["SaveVersion"]["Major"] = 1;
   out["SaveVersion"]["Minor"] = 2;
@@ -946,7 +1616,74 @@ void Reactor::toJsonFile(std::string fn) {
   out["UsedFuel"]["BaseHeat"] = 62.5;
   out["UsedFuel"]["FuelTime"] = 72000.0;
 
+  return out;
+}
+
+void Reactor::toJsonFile(std::string fn) {
+  std::ofstream outfile(fn, std::ios_base::binary);
+
+  outfile << toJson();
+}
+
+
+void Reactor::toHeatmapJsonFile(std::string fn) {
+  _evaluate();
+
+  Json::Value out;
+  out["InteriorDimensions"]["X"] = _x;
+  out["InteriorDimensions"]["Y"] = _y;
+  out["InteriorDimensions"]["Z"] = _z;
+
+  out["Totals"]["Power"] = powerGenerated(FuelType::generic);
+  out["Totals"]["Heat"] = heatGenerated(FuelType::generic);
+  out["Totals"]["Cooling"] = -heatGenerated(FuelType::air);
+  out["Totals"]["InactiveBlocks"] = static_cast<int>(_inactiveBlocks);
+
+  // dense [x][y][z] arrays, 0-based
+  Json::Value & power = out["Power"];
+  Json::Value & heat = out["Heat"];
+  Json::Value & cooling = out["Cooling"];
+  Json::Value & wasted = out["Wasted"];
+
+  for (int x = 0; x < _x; x++)
+  {
+    for (int y = 0; y < _y; y++)
+    {
+      for (int z = 0; z < _z; z++)
+      {
+        power[x][y][z] = _cellPower[_offset(x, y, z)];
+        heat[x][y][z] = _cellHeat[_offset(x, y, z)];
+        cooling[x][y][z] = _cellCooling[_offset(x, y, z)];
+        wasted[x][y][z] = static_cast<bool>(_cellWasted[_offset(x, y, z)]);
+      }
+    }
+  }
+
   std::ofstream outfile(fn, std::ios_base::binary);
 
   outfile << out;
 }
+
+/** Binary heatmap layout (little-endian, x-major like the cell storage):
+  *
+  *   char[4]  "NCHM"
+  *   int32    version (1)
+  *   int32    x, y, z
+  *   float32  power[x*y*z]
+  *   float32  heat[x*y*z]
+  *   float32  cooling[x*y*z]
+  *   uint8    wasted[x*y*z]
+  */
+void Reactor::toHeatmapBinaryFile(std::string fn) {
+  _evaluate();
+
+  std::ofstream outfile(fn, std::ios_base::binary);
+
+  int32_t header[] = { 1, _x, _y, _z };
+  outfile.write("NCHM", 4);
+  outfile.write(reinterpret_cast<const char *>(header), sizeof(header));
+  outfile.write(reinterpret_cast<const char *>(_cellPower.data()), _cellPower.size() * sizeof(float));
+  outfile.write(reinterpret_cast<const char *>(_cellHeat.data()), _cellHeat.size() * sizeof(float));
+  outfile.write(reinterpret_cast<const char *>(_cellCooling.data()), _cellCooling.size() * sizeof(float));
+  outfile.write(_cellWasted.data(), _cellWasted.size());
+}
@@ -0,0 +1,61 @@
+#ifndef __RESERVOIR_H__
+#define __RESERVOIR_H__
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <utility>
+
+/** Streaming weighted selection of a single item (A-Res, exponential keys).
+  *
+  * Every offered item gets the key E / w with E ~ Exp(1); the item with the
+  * smallest key wins. Item i is kept with probability w_i / sum(w), which is
+  * the same distribution std::discrete_distribution draws from, but only the
+  * current winner is ever stored.
+  *
+  * Items with a non-positive (or NaN) weight are only kept if nothing with a
+  * positive weight is ever offered.
+  */
+template <typename T>
+class WeightedReservoir {
+public:
+  WeightedReservoir() : _key(std::numeric_limits<double>::infinity()), _filled(false) {}
+
+  /** Offer an item. If it wins, it is swapped into the reservoir and `item`
+    * is left holding the previous winner (so its storage can be reused).
+    */
+  template <typename Engine>
+  bool offer(T & item, double weight, Engine & generator) {
+    double key = std::numeric_limits<double>::infinity();
+    if (weight > 0 && std::isfinite(weight)) {
+      key = std::exponential_distribution<double>(1.0)(generator) / weight;
+    }
+
+    if (!_filled || key < _key) {
+      std::swap(_item, item);
+      _key = key;
+      _filled = true;
+      return true;
+    }
+    return false;
+  }
+
+  /** Start over; the stored item is kept (for its storage) but no longer
+    * counts as offered.
+    */
+  inline void reset() {
+    _key = std::numeric_limits<double>::infinity();
+    _filled = false;
+  }
+
+  inline bool empty() const { return !_filled; }
+  inline T & item() { return _item; }
+  inline double key() const { return _key; }
+
+private:
+  T _item;
+  double _key;
+  bool _filled;
+};
+
+#endif
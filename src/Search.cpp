@@ -0,0 +1,1111 @@
+#include "Search.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <set>
+#include <deque>
+#include <random>
+#include <sstream>
+
+#include <omp.h>
+
+#include "Allocations.h"
+
+const std::vector<BlockType> shortBlockTypes = {
+  BlockType::air, //0
+  BlockType::reactorCell, //1
+  BlockType::moderator, //2
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+  // BlockType::cooler,
+
+};
+
+const std::vector<CoolerType> shortCoolerTypes_all = {
+  CoolerType::air,
+  CoolerType::air,
+  CoolerType::air,
+  // CoolerType::water,
+  // CoolerType::redstone,
+  // CoolerType::quartz,
+  // CoolerType::gold,
+  // CoolerType::glowstone,
+  // CoolerType::lapis,
+  // CoolerType::diamond,
+  // CoolerType::liquidHelium,
+  // CoolerType::enderium,
+  // CoolerType::cryotheum,
+  // CoolerType::iron,
+  // CoolerType::emerald,
+  // CoolerType::copper,
+  // CoolerType::tin,
+  // CoolerType::magnesium,
+  // CoolerType::activeCryotheum,
+};
+
+const std::vector<CoolerType> shortCoolerTypes_active = {
+  CoolerType::air,
+  CoolerType::air,
+  CoolerType::air,
+  // CoolerType::water,
+  // CoolerType::redstone,
+  // CoolerType::quartz,
+  // CoolerType::gold,
+  // CoolerType::glowstone,
+  // CoolerType::lapis,
+  // CoolerType::diamond,
+  // CoolerType::liquidHelium,
+  // CoolerType::enderium,
+  // CoolerType::cryotheum,
+  // CoolerType::iron,
+  // CoolerType::emerald,
+  // CoolerType::copper,
+  // CoolerType::tin,
+  // CoolerType::magnesium,
+  // CoolerType::activeCryotheum,
+};
+
+const std::vector<CoolerType> shortCoolerTypes_passive = {
+  CoolerType::air,
+  CoolerType::air,
+  CoolerType::air,
+  // CoolerType::water,
+  // CoolerType::redstone,
+  // CoolerType::quartz,
+  // CoolerType::gold,
+  // CoolerType::glowstone,
+  // CoolerType::lapis,
+  // CoolerType::diamond,
+  // CoolerType::liquidHelium,
+  // CoolerType::enderium,
+  // CoolerType::cryotheum,
+  // CoolerType::iron,
+  // CoolerType::emerald,
+  // CoolerType::copper,
+  // CoolerType::tin,
+  // CoolerType::magnesium,
+  // CoolerType::activeCryotheum,
+};
+
+float objective_fn_efficiency(Reactor & r, FuelType optimizeFuel)
+{
+  return (1e-10 + r.effectivePowerGenerated(optimizeFuel) / std::max(r.totalCells(), (largecount_t)1) + r.effectivePowerGenerated(optimizeFuel) / 100000.)
+          //- (r.heatGenerated(OPTIMIZE_FUEL) > 0 ? r.effectivePowerGenerated(OPTIMIZE_FUEL) : 0))
+          / (0.1 + r.inactiveBlocks() * r.inactiveBlocks() + (r.heatGenerated(optimizeFuel) > 0 ? r.heatGenerated(optimizeFuel) / 10000 : 0));
+          // - r.heatGenerated(FuelType::air) / 10;
+}
+
+float objective_fn_output(Reactor & r, FuelType optimizeFuel)
+{
+  return (1e-10 + r.effectivePowerGenerated(optimizeFuel))
+          / (0.1 + r.inactiveBlocks() * r.inactiveBlocks() + (r.heatGenerated(optimizeFuel) > 0 ? r.heatGenerated(optimizeFuel) / 10000 : 0))
+          - r.heatGenerated(FuelType::air) / 10;
+}
+
+float objective_fn_cells(Reactor & r, FuelType optimizeFuel)
+{
+  float mult = r.heatGenerated(optimizeFuel) <= 0 ? 1 : (r.heatGenerated(FuelType::air) / (r.heatGenerated(FuelType::air) - r.heatGenerated(optimizeFuel)));
+  return (1e-10 + r.totalCells() * mult)
+          / (1 + r.inactiveBlocks() * r.inactiveBlocks()); // + (r.heatGenerated(optimizeFuel) <= 0 ? 0 : (r.heatGenerated(optimizeFuel)) / 50000));
+}
+
+float objectiveMetric(Reactor & r, FuelType f, objective_fn_t objective_fn)
+{
+  if (objective_fn == objective_fn_output) {
+    return r.effectivePowerGenerated(f);
+  }
+  if (objective_fn == objective_fn_cells) {
+    float mult = r.heatGenerated(f) <= 0 ? 1 : (r.heatGenerated(FuelType::air) / (r.heatGenerated(FuelType::air) - r.heatGenerated(f)));
+    return r.totalCells() * mult;
+  }
+  return r.effectivePowerGenerated(f) / std::max(r.totalCells(), (largecount_t)1);
+}
+
+float objectiveCeiling(const ScoreBound & b, objective_fn_t objective_fn)
+{
+  if (objective_fn == objective_fn_output) {
+    return b.effectivePower;
+  }
+  if (objective_fn == objective_fn_cells) {
+    return b.cells;
+  }
+  return b.efficiency;
+}
+
+void objectiveAllFuels(Reactor & r, objective_fn_t objective_fn, const std::vector<FuelType> & fuels, float * out)
+{
+  // the objective_fn_* formulas with the per-fuel quantities looked up in
+  // fuelTotals' output; results are identical
+  const int chunk = static_cast<int>(FuelType::FUEL_TYPE_MAX);
+  float power[chunk], heat[chunk], effective[chunk];
+
+  // evaluates r (inactiveBlocks doesn't)
+  const float cooling = r.heatGenerated(FuelType::air);
+  const auto cells = std::max(r.totalCells(), (largecount_t)1);
+  const auto totalCells = r.totalCells();
+  const auto inactive = r.inactiveBlocks();
+
+  for (int from = 0; from < (int)fuels.size(); from += chunk)
+  {
+    int n = std::min(chunk, (int)fuels.size() - from);
+    float * o = out + from;
+    r.fuelTotals(fuels.data() + from, n, power, heat, effective);
+
+    if (objective_fn == objective_fn_efficiency) {
+      #pragma omp simd
+      for (int i = 0; i < n; i++) {
+        o[i] = (1e-10 + effective[i] / cells + effective[i] / 100000.)
+          / (0.1 + inactive * inactive + (heat[i] > 0 ? heat[i] / 10000 : 0));
+      }
+    }
+    else if (objective_fn == objective_fn_output) {
+      #pragma omp simd
+      for (int i = 0; i < n; i++) {
+        o[i] = (1e-10 + effective[i])
+          / (0.1 + inactive * inactive + (heat[i] > 0 ? heat[i] / 10000 : 0))
+          - cooling / 10;
+      }
+    }
+    else if (objective_fn == objective_fn_cells) {
+      #pragma omp simd
+      for (int i = 0; i < n; i++) {
+        float mult = heat[i] <= 0 ? 1 : (cooling / (cooling - heat[i]));
+        o[i] = (1e-10 + totalCells * mult) / (1 + inactive * inactive);
+      }
+    }
+    else {
+      for (int i = 0; i < n; i++) {
+        o[i] = objective_fn(r, fuels[from + i]);
+      }
+    }
+  }
+}
+
+static const objective_fn_t strategyObjectives[] = {
+  objective_fn_efficiency,
+  objective_fn_output,
+  objective_fn_cells,
+};
+
+static const char * strategyNames[] = {
+  "efficiency",
+  "output",
+  "cells",
+};
+
+#define NUM_STRATEGIES (int)(sizeof(strategyObjectives) / sizeof(strategyObjectives[0]))
+
+objective_fn_t objectiveForStrategy(int strategy)
+{
+  return strategy >= 0 && strategy < NUM_STRATEGIES ? strategyObjectives[strategy] : nullptr;
+}
+
+int strategyForObjective(objective_fn_t objective_fn)
+{
+  for (int s = 0; s < NUM_STRATEGIES; s++) {
+    if (strategyObjectives[s] == objective_fn) return s;
+  }
+  return -1;
+}
+
+const char * strategyName(int strategy)
+{
+  return strategy >= 0 && strategy < NUM_STRATEGIES ? strategyNames[strategy] : "???";
+}
+
+// with a portfolio / in Pareto mode, each thread switches to the next fuel /
+// objective this often
+#define ROTATE_EVERY 500
+
+// one in this many candidates discarded by the surrogate is evaluated anyway
+// to measure its hit / miss rate
+#define SURROGATE_AUDIT_EVERY 20
+
+// steps before the step buffers have grown to size; allocations are only
+// counted after these (see printStats)
+#define ALLOCATION_WARMUP_STEPS 100
+
+std::set<Reactor> tabuSet;
+std::deque<Reactor> tabuList;
+
+Search::Search(const Reactor & initial, const SearchOptions & options)
+  : _options(options), _best(initial), _step(0), _monitor(options.stop),
+    _topK(std::max(options.topK, 0), options.topKMinDistance > 0 ? options.topKMinDistance : std::max(1, (int)initial.volume() / 10))
+{
+  switch (_options.coolerRestrictions) {
+    case 0:
+      _shortCoolerTypes = &shortCoolerTypes_all;
+      break;
+    case 2:
+      _shortCoolerTypes = &shortCoolerTypes_active;
+      break;
+    default:
+      _shortCoolerTypes = &shortCoolerTypes_passive;
+      break;
+  }
+
+  _symmetry = nullptr;
+  if (_options.symmetry != SymmetryGroup::Kind::none) {
+    _symmetry = &SymmetryGroup::forDimensions(_best.x(), _best.y(), _best.z(), _options.symmetry);
+    _symmetry->symmetrize(_best);
+  }
+
+  _options.threads = std::max(_options.threads, 1u);
+  _reactors.assign(_options.threads, _best);
+  _stepAllocations.assign(_options.threads, 0);
+  for (unsigned int j = 0; j < _options.threads; j++) {
+    _workspaces.push_back(std::make_unique<Workspace>());
+  }
+
+  std::seed_seq seq{_options.seed};
+  _generator.seed(seq);
+  for (unsigned int j = 0; j < _options.threads; j++) {
+    std::seed_seq threadSeq{_options.seed, (unsigned long)j + 1};
+    _generators.emplace_back(threadSeq);
+  }
+
+  if (_options.surrogate) {
+    _surrogates.assign(_options.threads, Surrogate(_options.surrogateDiscardBelow));
+  }
+
+  if (!_options.portfolio.empty()) {
+    std::vector<FuelType> fuels = {_options.fuel};
+    for (FuelType f : _options.portfolio) {
+      if (f != FuelType::air && f != FuelType::generic && std::find(fuels.begin(), fuels.end(), f) == fuels.end()) {
+        fuels.push_back(f);
+      }
+    }
+    _options.portfolio = fuels;
+
+    _portfolio.scores.resize(fuels.size());
+    _portfolio.best.assign(fuels.size(), _best);
+    objectiveAllFuels(_best, _options.objective, fuels, _portfolio.scores.data());
+    _threadPortfolios.assign(_options.threads, Portfolio{_portfolio.scores, std::vector<Reactor>(fuels.size())});
+  }
+
+  _bound = scoreBound(_best.x(), _best.y(), _best.z(), _options.fuel);
+  _ceiling = objectiveCeiling(_bound, _options.objective);
+
+  // keep a little of the time limit back for writing out results
+  double margin = std::min(1.0, std::max(0.01, _options.timeLimit * 0.05));
+  _deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+    std::chrono::duration<double>(std::max(0.0, _options.timeLimit - margin)));
+  _longestStep = 0;
+}
+
+float Search::gap(Reactor & r)
+{
+  float achieved = objectiveMetric(r, _options.fuel, _options.objective);
+  return _ceiling > 0 ? std::max(0.f, 1 - achieved / _ceiling) : 0.f;
+}
+
+float Search::diversity()
+{
+  if (_reactors.size() < 2) {
+    return -1;
+  }
+
+  double total = 0;
+  int pairs = 0;
+  for (size_t a = 0; a < _reactors.size(); a++) {
+    for (size_t b = a + 1; b < _reactors.size(); b++) {
+      total += (double)_reactors[a].differingCells(_reactors[b]) / _reactors[a].volume();
+      pairs++;
+    }
+  }
+  return total / pairs;
+}
+
+void Search::run()
+{
+  const FuelType optimizeFuel = _options.fuel;
+  const objective_fn_t objective_fn = _options.objective;
+
+  while(true)
+  {
+    std::string why;
+    if(_monitor.shouldStop(why)) {
+      if(_options.logEvery) fprintf(stderr, "stopping at step %ld: %s\n", _step, why.c_str());
+      break;
+    }
+
+    // don't start a step that likely won't finish in time
+    if(_options.timeLimit > 0) {
+      double left = std::chrono::duration<double>(_deadline - std::chrono::steady_clock::now()).count();
+      if(left < _longestStep) {
+        if(_options.logEvery) fprintf(stderr, "stopping at step %ld: time limit\n", _step);
+        break;
+      }
+    }
+
+    auto stepStart = std::chrono::steady_clock::now();
+
+    int i = _step;
+
+    if(_options.logEvery && !(i % _options.logEvery)) fprintf(stderr, "step %u %f %lld %f %f gap %.2f%%\n", i, objective_fn(_reactors[0], optimizeFuel), (long long)_best.totalCells(), _best.effectivePowerGenerated(optimizeFuel), _best.effectivePowerGenerated(optimizeFuel) / std::max(_best.totalCells(), (largecount_t)1), 100 * gap(_best));
+    // portfolio: the threads move on to their next fuel, from its best design
+    const size_t portfolioSize = _options.portfolio.size();
+    if(portfolioSize && i > 0 && !(i % ROTATE_EVERY)) {
+      for(int j = 0; j < (int)_options.threads; j++) {
+        _reactors[j] = _portfolio.best[(j + i / ROTATE_EVERY) % portfolioSize];
+      }
+    }
+
+    #pragma omp parallel for num_threads(_options.threads)
+    for(int j = 0; j < (int)_options.threads; j++) {
+      uint64_t before = threadAllocations();
+      _stepRnd(j, i);
+      if(i >= ALLOCATION_WARMUP_STEPS) {
+        _stepAllocations[j] += threadAllocations() - before;
+      }
+    }
+    bool improved = false;
+    if(portfolioSize && _mergePortfolio() && _portfolio.scores[0] > objective_fn(_best, optimizeFuel)) {
+      _best = _portfolio.best[0];
+      improved = true;
+    }
+    for(int j = 0; j < (int)_options.threads; j++) {
+      if(objective_fn(_reactors[j], optimizeFuel) > objective_fn(_best, optimizeFuel))
+      {
+        _best = _reactors[j];
+        improved = true;
+      }
+      //if(!(i % 250) || (!(i % 250) && objective_fn(_reactors[j], optimizeFuel) < 1.)) _reactors[j] = _best;
+      if (std::uniform_int_distribution<int>(0, 249)(_generator) == 0) {
+        size_t archived = _options.pareto ? _archive.size() : 0;
+        if (archived) {
+          _reactors[j] = _archive.member(std::uniform_int_distribution<size_t>(0, archived - 1)(_generator));
+        }
+        else {
+          _reactors[j] = portfolioSize ? _portfolio.best[(j + i / ROTATE_EVERY) % portfolioSize] : _best;
+        }
+      }
+    }
+
+    _step++;
+
+    _longestStep = std::max(_longestStep, std::chrono::duration<double>(std::chrono::steady_clock::now() - stepStart).count());
+
+    if(_options.onNewBest) {
+      if(improved) {
+        _options.onNewBest(*this, "improvement");
+      }
+      if(_options.snapshotRequested && *_options.snapshotRequested) {
+        *_options.snapshotRequested = false;
+        _options.onNewBest(*this, "snapshot");
+      }
+    }
+
+    // diversity is quadratic in the number of threads, so only now and then
+    _monitor.observe(_step, objective_fn(_best, optimizeFuel), objectiveMetric(_best, optimizeFuel, objective_fn), (i % 50) ? -1 : diversity());
+
+    if(!_options.checkpointPath.empty() && _options.checkpointEvery > 0 && !(_step % _options.checkpointEvery)) {
+      saveCheckpoint(_options.checkpointPath);
+    }
+
+    if(_best.inactiveBlocks() == 0 && gap(_best) <= _options.gapTarget) {
+      if(_options.logEvery) fprintf(stderr, "gap %.2f%% reached at step %u\n", 100 * gap(_best), i);
+      break;
+    }
+
+    if(_options.interrupted && *_options.interrupted) break;
+    if(_pastDeadline()) break;
+  }
+
+  if(!_options.checkpointPath.empty()) {
+    saveCheckpoint(_options.checkpointPath);
+  }
+}
+
+void Search::printStats()
+{
+  if (_step > ALLOCATION_WARMUP_STEPS) {
+    uint64_t allocations = 0;
+    for (uint64_t a : _stepAllocations) {
+      allocations += a;
+    }
+    fprintf(stderr, "heap allocations by search threads after step %d: %lu (%.2f per thread step)\n", ALLOCATION_WARMUP_STEPS,
+      (unsigned long)allocations, (double)allocations / (_step - ALLOCATION_WARMUP_STEPS) / _options.threads);
+  }
+
+  if (_archive.size() || _topK.size()) {
+    size_t distinct, references;
+    Genome::chunkStats(distinct, references);
+    // (small designs are stored inline, without chunks)
+    if (references) {
+      fprintf(stderr, "stored designs: %zu chunks shared between %zu uses (%.1f KB, %.1f KB unshared)\n",
+        distinct, references, distinct * sizeof(Genome::Chunk) / 1024., references * sizeof(Genome::Chunk) / 1024.);
+    }
+  }
+
+  if (_options.twoTierCalibrate && _twoTierStats.steps) {
+    fprintf(stderr, "two-tier calibration (K = %d): %ld steps, %ld candidates\n", _options.twoTierK, _twoTierStats.steps, _twoTierStats.candidates);
+    fprintf(stderr, "  exact best not shortlisted in %.2f%% of steps\n", 100. * _twoTierStats.bestMissed / _twoTierStats.steps);
+    fprintf(stderr, "  selection would differ in %.2f%% of steps (mean total variation)\n", 100. * _twoTierStats.selectionTV / _twoTierStats.steps);
+    fprintf(stderr, "  mean relative weight error %.4f\n", _twoTierStats.relativeError / _twoTierStats.candidates);
+  }
+
+  if (_options.surrogate) {
+    Surrogate::Stats st;
+    float rmse = 0;
+    for (const Surrogate & m : _surrogates) {
+      st += m.stats;
+      rmse += m.rmse() / _surrogates.size();
+    }
+    double meanEval = st.evals ? st.evalSeconds / st.evals : 0;
+    fprintf(stderr, "surrogate: %ld candidates seen, %ld discarded (%.2f%%), %ld trained, rmse %.3f\n",
+      st.seen, st.discarded, st.seen ? 100. * st.discarded / st.seen : 0., st.trained, rmse);
+    fprintf(stderr, "  audited %ld discards: %ld hits, %ld misses (miss rate %.2f%%)\n",
+      st.audited, st.hits, st.misses, st.audited ? 100. * st.misses / st.audited : 0.);
+    fprintf(stderr, "  ~%.2fs of evaluation skipped, %.2fs spent extracting features\n",
+      (st.discarded - st.audited) * meanEval, st.featureSeconds);
+  }
+}
+
+static std::string engineState(const std::default_random_engine & e)
+{
+  std::ostringstream os;
+  os << e;
+  return os.str();
+}
+
+static bool setEngineState(std::default_random_engine & e, const std::string & state)
+{
+  std::istringstream is(state);
+  is >> e;
+  return !is.fail();
+}
+
+void Search::_saveSettings(CheckpointWriter & out, const SearchOptions & options)
+{
+  out.put<int32_t>(static_cast<int32_t>(options.fuel));
+  out.put<int32_t>(std::max(strategyForObjective(options.objective), 0));
+  out.put<int32_t>(options.coolerRestrictions);
+  out.put<uint32_t>(options.threads);
+  out.put<uint8_t>(options.repair);
+  out.put<int32_t>(options.twoTierK);
+  out.put<uint8_t>(options.twoTierCalibrate);
+  out.put<uint8_t>(options.surrogate);
+  out.put(options.surrogateDiscardBelow);
+  out.put<uint8_t>(options.pareto);
+  out.put<int32_t>(static_cast<int32_t>(options.symmetry));
+  out.put<int32_t>(options.topK);
+  out.put<int32_t>(options.topKMinDistance);
+  out.put<uint32_t>(options.portfolio.size());
+  for(FuelType f : options.portfolio) {
+    out.put<int32_t>(static_cast<int32_t>(f));
+  }
+}
+
+bool Search::_loadSettings(CheckpointReader & in, SearchOptions & options)
+{
+  int32_t fuel, objective, coolerRestrictions, twoTierK;
+  uint32_t threads;
+  uint8_t repair, twoTierCalibrate, surrogate;
+  float discardBelow;
+  if(!in.get(fuel) || !in.get(objective) || !in.get(coolerRestrictions) || !in.get(threads) || !in.get(repair)
+      || !in.get(twoTierK) || !in.get(twoTierCalibrate) || !in.get(surrogate) || !in.get(discardBelow)) {
+    return false;
+  }
+  // (every thread's reactor follows, so there can't be more threads than
+  // bytes left)
+  if(fuel < 0 || fuel >= static_cast<int32_t>(FuelType::FUEL_TYPE_MAX) || !objectiveForStrategy(objective) || threads < 1
+      || threads > in.remaining()) {
+    return false;
+  }
+
+  options.fuel = static_cast<FuelType>(fuel);
+  options.objective = objectiveForStrategy(objective);
+  options.coolerRestrictions = coolerRestrictions;
+  options.threads = threads;
+  options.repair = repair;
+  options.twoTierK = twoTierK;
+  options.twoTierCalibrate = twoTierCalibrate;
+  options.surrogate = surrogate;
+  options.surrogateDiscardBelow = discardBelow;
+
+  uint8_t pareto;
+  if(!in.get(pareto)) {
+    return false;
+  }
+  options.pareto = pareto;
+
+  int32_t symmetry, topK, topKMinDistance;
+  if(!in.get(symmetry) || !in.get(topK) || !in.get(topKMinDistance)
+      || symmetry < 0 || symmetry > static_cast<int32_t>(SymmetryGroup::Kind::full)) {
+    return false;
+  }
+  options.symmetry = static_cast<SymmetryGroup::Kind>(symmetry);
+  options.topK = topK;
+  options.topKMinDistance = topKMinDistance;
+
+  uint32_t portfolioSize;
+  if(!in.get(portfolioSize) || portfolioSize > static_cast<uint32_t>(FuelType::FUEL_TYPE_MAX)) {
+    return false;
+  }
+  options.portfolio.clear();
+  for(uint32_t k = 0; k < portfolioSize; k++) {
+    int32_t f;
+    if(!in.get(f) || f < 0 || f >= static_cast<int32_t>(FuelType::FUEL_TYPE_MAX)) {
+      return false;
+    }
+    options.portfolio.push_back(static_cast<FuelType>(f));
+  }
+  return true;
+}
+
+bool Search::saveCheckpoint(const std::string & path)
+{
+  CheckpointWriter out;
+  _saveSettings(out, _options);
+  out.putReactor(_best);
+
+  out.put<int64_t>(_step);
+  _monitor.save(out);
+  out.putString(engineState(_generator));
+
+  for(unsigned int j = 0; j < _options.threads; j++) {
+    out.putReactor(_reactors[j]);
+    out.putString(engineState(_generators[j]));
+    if(_options.surrogate) {
+      _surrogates[j].save(out);
+    }
+  }
+
+  out.put(_twoTierStats);
+
+  for(size_t k = 0; k < _portfolio.scores.size(); k++) {
+    out.put(_portfolio.scores[k]);
+    out.putReactor(_portfolio.best[k]);
+  }
+
+  if(_options.pareto) {
+    _archive.save(out);
+  }
+  if(_options.topK > 0) {
+    _topK.save(out);
+  }
+
+  return out.writeFile(path);
+}
+
+unsigned int Search::threadsWithinMemory(largecount_t volume, const SearchOptions & options, size_t budget)
+{
+  size_t reactor = Reactor::evaluatedBytes(volume);
+  size_t perThread = (4 + options.portfolio.size()) * reactor;
+  size_t shared = (1 + options.portfolio.size()) * reactor;
+  size_t fit = budget > shared ? (budget - shared) / perThread : 0;
+  return std::clamp<size_t>(fit, 1, std::max(options.threads, 1u));
+}
+
+bool Search::checkpointSettings(const std::string & path, SearchOptions & options, Reactor & best)
+{
+  CheckpointReader in(path);
+  if(!_loadSettings(in, options) || !in.getReactor(best)) {
+    if(in.ok()) fprintf(stderr, "checkpoint %s is unreadable\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool Search::resume(const std::string & path)
+{
+  CheckpointReader in(path);
+
+  SearchOptions saved = _options;
+  Reactor best;
+  int64_t step;
+  std::string state;
+  if(!_loadSettings(in, saved) || !in.getReactor(best) || !in.get(step) || !_monitor.load(in)
+      || !in.getString(state) || !setEngineState(_generator, state)) {
+    fprintf(stderr, "checkpoint %s is unreadable\n", path.c_str());
+    return false;
+  }
+
+  if(saved.threads != _options.threads || saved.fuel != _options.fuel || saved.objective != _options.objective
+      || saved.surrogate != _options.surrogate || saved.portfolio != _options.portfolio || saved.pareto != _options.pareto
+      || saved.topK != _options.topK || saved.symmetry != _options.symmetry || best.x() != _best.x() || best.y() != _best.y() || best.z() != _best.z()) {
+    fprintf(stderr, "checkpoint %s doesn't match this search's settings\n", path.c_str());
+    return false;
+  }
+
+  for(unsigned int j = 0; j < _options.threads; j++) {
+    if(!in.getReactor(_reactors[j]) || !in.getString(state) || !setEngineState(_generators[j], state)
+        || (_options.surrogate && !_surrogates[j].load(in))) {
+      fprintf(stderr, "checkpoint %s is unreadable\n", path.c_str());
+      return false;
+    }
+  }
+
+  if(!in.get(_twoTierStats)) {
+    fprintf(stderr, "checkpoint %s is unreadable\n", path.c_str());
+    return false;
+  }
+
+  for(size_t k = 0; k < _portfolio.scores.size(); k++) {
+    if(!in.get(_portfolio.scores[k]) || !in.getReactor(_portfolio.best[k])) {
+      fprintf(stderr, "checkpoint %s is unreadable\n", path.c_str());
+      return false;
+    }
+  }
+  for(Portfolio & local : _threadPortfolios) {
+    local.scores = _portfolio.scores;
+  }
+
+  if((_options.pareto && !_archive.load(in)) || (_options.topK > 0 && !_topK.load(in))) {
+    fprintf(stderr, "checkpoint %s is unreadable\n", path.c_str());
+    return false;
+  }
+
+  _best = best;
+  _step = step;
+  return true;
+}
+
+FuelType Search::_drivingFuel(int j, long idx) const
+{
+  if(_options.portfolio.empty()) {
+    return _options.fuel;
+  }
+  return _options.portfolio[(j + idx / ROTATE_EVERY) % _options.portfolio.size()];
+}
+
+objective_fn_t Search::_drivingObjective(int j, long idx) const
+{
+  if(!_options.pareto) {
+    return _options.objective;
+  }
+  int first = std::max(strategyForObjective(_options.objective), 0);
+  return objectiveForStrategy((first + j + idx / ROTATE_EVERY) % NUM_STRATEGIES);
+}
+
+void Search::_observeCandidate(int j, Reactor & c)
+{
+  if(_options.pareto) {
+    _archive.offer(c, _options.fuel);
+  }
+
+  if(_options.topK > 0) {
+    _topK.offer(c, _options.objective(c, _options.fuel));
+  }
+
+  if(_options.portfolio.empty()) {
+    return;
+  }
+
+  Portfolio & local = _threadPortfolios[j];
+  float scores[static_cast<int>(FuelType::FUEL_TYPE_MAX)];
+  objectiveAllFuels(c, _options.objective, _options.portfolio, scores);
+  for(size_t k = 0; k < _options.portfolio.size(); k++) {
+    if(scores[k] > local.scores[k]) {
+      local.scores[k] = scores[k];
+      local.best[k] = c;
+    }
+  }
+}
+
+bool Search::_mergePortfolio()
+{
+  bool improved = false;
+  for(Portfolio & local : _threadPortfolios) {
+    for(size_t k = 0; k < _portfolio.scores.size(); k++) {
+      if(local.scores[k] > _portfolio.scores[k]) {
+        _portfolio.scores[k] = local.scores[k];
+        // (swapped, so both keep their storage)
+        std::swap(_portfolio.best[k], local.best[k]);
+        improved |= k == 0;
+      }
+    }
+  }
+
+  // from now on, threads only keep what beats the merged bests
+  for(Portfolio & local : _threadPortfolios) {
+    local.scores = _portfolio.scores;
+  }
+  return improved;
+}
+
+void Search::_stepRnd(int j, int idx)
+{
+  Reactor & r = _reactors[j];
+  Surrogate * model = _options.surrogate ? &_surrogates[j] : nullptr;
+  std::default_random_engine & generator = _generators[j];
+  const FuelType f = _drivingFuel(j, idx);
+  const objective_fn_t objective_fn = _drivingObjective(j, idx);
+
+  Workspace & ws = *_workspaces[j];
+  ws.arena.reset();
+
+  // candidates are streamed through the reservoir as they are scored, so
+  // only the current pick and the candidate being built are ever alive
+  WeightedReservoir<Reactor> & picked = ws.picked;
+  picked.reset();
+  Reactor & r1 = ws.candidate;
+
+  // edits making up the move being built, mirror images included, and the
+  // cells they actually changed once applied
+  std::vector<CellChange> & changes = ws.changes;
+  std::vector<coord_t> & edits = ws.edits;
+  changes.clear();
+
+  // early on, every edit is mirrored to "kickstart" the search (unless the
+  // search is constrained to a symmetry anyway)
+  bool symmetric = !_symmetry && r.x() > 2 && r.y() > 2 && r.z() > 2 && idx < 2000;
+
+  auto place = [&](int x, int y, int z, BlockType bt, CoolerType ct) {
+    if (_symmetry && r1.isInBounds(x, y, z)) {
+      for (uint32_t n : _symmetry->orbit(r1.cellIndex(x, y, z))) {
+        coord_t c = r1.coordinatesOf(n);
+        changes.push_back({UNPACK(c), bt, ct});
+      }
+    }
+    else {
+      changes.push_back({static_cast<index_t>(x), static_cast<index_t>(y), static_cast<index_t>(z), bt, ct});
+    }
+  };
+
+  auto weigh = [&](Reactor & c, float s, bool floor) {
+    double score = pow(objective_fn(c, f), 1. + (float)(idx % 10000) / 5000);
+    if (floor) {
+      score = std::max(score, 0.01);
+    }
+    return score * s;
+  };
+
+  // repair blocks made inactive and exact scoring don't mix with an
+  // approximate score, so two-tier only applies without repair
+  bool twoTier = _options.twoTierK > 0 && !_options.repair;
+
+  // min-heap (on approximate weight) of the K best candidates so far; they
+  // are offered to the reservoir with their exact weight at the end. anything
+  // that doesn't make it is offered with its approximate weight right away.
+  // the first `shortlisted` entries are this step's (the rest are kept for
+  // their reactors' storage)
+  auto shortlistOrder = [](const Shortlisted & a, const Shortlisted & b) { return a.weight > b.weight; };
+  std::vector<Shortlisted> & shortlist = ws.shortlist;
+  size_t shortlisted = 0;
+
+  // (approximate, exact) weight of every candidate, for --two-tier-calibrate
+  std::pmr::vector<std::pair<double, double> > calibration(&ws.arena);
+  int candidateId = 0;
+
+  // the surrogate learns log(objective(candidate) / objective(r))
+  Surrogate::features_t features;
+  double parentLogObjective = model ? log(std::max((double)objective_fn(r, f), 1e-10)) : 0;
+  auto logRatio = [&](Reactor & c) {
+    return (float)(log(std::max((double)objective_fn(c, f), 1e-10)) - parentLogObjective);
+  };
+  auto weighExact = [&](Reactor & c, float s, bool floor, const Surrogate::features_t & cf) {
+    double t0 = omp_get_wtime();
+    double w = weigh(c, s, floor);
+    _observeCandidate(j, c);
+    if(model) {
+      model->stats.evalSeconds += omp_get_wtime() - t0;
+      model->stats.evals++;
+      model->train(cf, logRatio(c));
+    }
+    return w;
+  };
+
+  auto submit = [&](float s, bool floor) {
+    edits.clear();
+    r1.applyCells(changes, edits);
+    changes.clear();
+
+    // repair would break symmetry
+    if(_options.repair && !symmetric && !_symmetry) {
+      r1.repairInactive(r, edits);
+    }
+
+    if(model) {
+      double t0 = omp_get_wtime();
+      Surrogate::extractFeatures(r, r1, edits, features);
+      model->stats.featureSeconds += omp_get_wtime() - t0;
+      model->stats.seen++;
+
+      if(model->shouldDiscard(features)) {
+        model->stats.discarded++;
+        if(std::uniform_int_distribution<int>(0, SURROGATE_AUDIT_EVERY - 1)(generator) == 0) {
+          model->stats.audited++;
+          weighExact(r1, s, floor, features);
+          if(model->isBad(logRatio(r1))) {
+            model->stats.hits++;
+          }
+          else {
+            model->stats.misses++;
+          }
+        }
+        return;
+      }
+    }
+
+    if(!twoTier) {
+      // if(!tabuSet.count(r1) || m == 0) {
+        picked.offer(r1, weighExact(r1, s, floor, features), generator);
+      // }
+      return;
+    }
+
+    int id = candidateId++;
+    if(_options.twoTierCalibrate) {
+      Reactor & exact = ws.calibrationCopy;
+      exact = r1;
+      exact.invalidate();
+      calibration.push_back(std::make_pair(0., weigh(exact, s, floor)));
+    }
+
+    r1.evaluateApproximate(edits);
+    double w = weigh(r1, s, floor);
+
+    if(_options.twoTierCalibrate) {
+      calibration[id].first = w;
+    }
+
+    if((int)shortlisted < _options.twoTierK) {
+      if(shortlisted == shortlist.size()) {
+        shortlist.emplace_back();
+      }
+      Shortlisted & added = shortlist[shortlisted++];
+      std::swap(added.reactor, r1);
+      added.weight = w;
+      added.s = s;
+      added.floor = floor;
+      added.id = id;
+      added.features = features;
+      std::push_heap(shortlist.begin(), shortlist.begin() + shortlisted, shortlistOrder);
+      return;
+    }
+
+    if(w > shortlist.front().weight) {
+      std::pop_heap(shortlist.begin(), shortlist.begin() + shortlisted, shortlistOrder);
+      Shortlisted & evicted = shortlist[shortlisted - 1];
+      std::swap(evicted.reactor, r1);
+      std::swap(evicted.weight, w);
+      evicted.s = s;
+      evicted.floor = floor;
+      evicted.id = id;
+      evicted.features = features;
+      std::push_heap(shortlist.begin(), shortlist.begin() + shortlisted, shortlistOrder);
+    }
+
+    picked.offer(r1, w, generator);
+  };
+
+  // principled extension
+  std::pmr::vector<std::tuple<coord_t, BlockType, CoolerType, float> > principledActions(&ws.arena);
+
+  std::pmr::vector<coord_t> principledLocations(&ws.arena);
+  r.suggestPrincipledLocations(principledLocations);
+
+  // constrained to a symmetry, a location stands for its whole orbit
+  if(_symmetry) {
+    for(coord_t & ploc : principledLocations) {
+      ploc = r.coordinatesOf(_symmetry->representative(r.cellIndex(UNPACK(ploc))));
+    }
+    std::sort(principledLocations.begin(), principledLocations.end());
+    principledLocations.erase(std::unique(principledLocations.begin(), principledLocations.end()), principledLocations.end());
+  }
+  std::pmr::vector<Reactor::suggestion_t> suggestedBlocks(&ws.arena);
+  for(const coord_t & ploc : principledLocations)
+  {
+    BlockType bt = r.blockTypeAt(UNPACK(ploc));
+    // if (bt != BlockType::reactorCell && bt != BlockType::moderator) {
+      suggestedBlocks.clear();
+      r.suggestedBlocksAt(UNPACK(ploc), f, suggestedBlocks);
+      for (const auto & tpl : suggestedBlocks)
+      {
+        principledActions.push_back(std::tuple_cat(std::make_tuple(ploc), tpl));
+      }
+    // }
+  }
+
+  if(principledActions.size())
+  {
+    // #pragma omp parallel for
+    for(int m = 0; m < 100 && !_pastDeadline(); m++)
+    {
+      r1 = r;
+
+      int nn = std::uniform_int_distribution<int>(1, 2)(generator);
+      float s = 0;
+      for(int n = 0; n < nn; n++)
+      {
+        int i = std::uniform_int_distribution<int>(0, principledActions.size() - 1)(generator);
+        auto theAction = principledActions[i];
+
+        coord_t where = std::get<0>(theAction);
+        BlockType bt = std::get<1>(theAction);
+        CoolerType ct = std::get<2>(theAction);
+        float _s = std::get<3>(theAction);
+
+        int x = where[0];
+        int y = where[1];
+        int z = where[2];
+
+        place(x, y, z, bt, ct);
+        if(symmetric) {
+          place(r.x() - 1 - x, y, z, bt, ct);
+          place(x, y, r.z() - 1 - z, bt, ct);
+          place(r.x() - 1 - x, y, r.z() - 1 - z, bt, ct);
+          place(x, r.y() - 1 - y, z, bt, ct);
+          place(r.x() - 1 - x, r.y() - 1 - y, z, bt, ct);
+          place(x, r.y() - 1 - y, r.z() - 1 - z, bt, ct);
+          place(r.x() - 1 - x, r.y() - 1 - y, r.z() - 1 - z, bt, ct);
+        }
+        s += _s;
+      }
+      submit(s, true);
+    }
+  }
+
+  // random mutations are proposed where the evaluator thinks improvements
+  // are likely (inactive blocks, weak coolers, under-connected cells)
+  // (std::discrete_distribution would allocate its table on the heap: this
+  // is the same thing, with the running totals in the arena)
+  const std::vector<float> & mutationWeights = r.mutationWeights();
+  std::pmr::vector<double> siteTotals(&ws.arena);
+  double total = 0;
+  if(_symmetry) {
+    // sites are orbit representatives, weighted by their whole orbit
+    siteTotals.reserve(_symmetry->representatives().size());
+    for(uint32_t n : _symmetry->representatives()) {
+      for(uint32_t m : _symmetry->orbit(n)) {
+        total += mutationWeights[m];
+      }
+      siteTotals.push_back(total);
+    }
+  }
+  else {
+    siteTotals.reserve(mutationWeights.size());
+    for(float w : mutationWeights) {
+      total += w;
+      siteTotals.push_back(total);
+    }
+  }
+  auto mutationSite = [&](std::default_random_engine & g) {
+    double u = std::uniform_real_distribution<double>(0, total)(g);
+    return (int)std::min<size_t>(std::upper_bound(siteTotals.begin(), siteTotals.end(), u) - siteTotals.begin(), siteTotals.size() - 1);
+  };
+
+  // #pragma omp parallel for
+  for(int m = 0; m < 50 && !_pastDeadline(); m++)
+  {
+    int x, y, z, i;
+
+    r1 = r;
+
+    int nn = std::uniform_int_distribution<int>(1, 4)(generator);;
+    for(int n = 0; n < nn; n++) {
+      int drawn = mutationSite(generator);
+      coord_t site = r.coordinatesOf(_symmetry ? _symmetry->representatives()[drawn] : drawn);
+      x = site[0];
+      y = site[1];
+      z = site[2];
+      i = std::uniform_int_distribution<int>(0, _shortCoolerTypes->size() - 1)(generator);
+      // if (shortBlockTypes[i] != BlockType::reactorCell && r.blockTypeAt(x, y, z) != BlockType::reactorCell && r.blockTypeAt(x, y, z) != BlockType::moderator )
+      if(1)
+      {
+        place(x, y, z, shortBlockTypes[i], (*_shortCoolerTypes)[i]);
+        if(symmetric) {
+          place(r.x() - 1 - x, y, z, shortBlockTypes[i], (*_shortCoolerTypes)[i]);
+          place(x, y, r.z() - 1 - z, shortBlockTypes[i], (*_shortCoolerTypes)[i]);
+          place(r.x() - 1 - x, y, r.z() - 1 - z, shortBlockTypes[i], (*_shortCoolerTypes)[i]);
+          place(x, r.y() - 1 - y, z, shortBlockTypes[i], (*_shortCoolerTypes)[i]);
+          place(r.x() - 1 - x, r.y() - 1 - y, z, shortBlockTypes[i], (*_shortCoolerTypes)[i]);
+          place(x, r.y() - 1 - y, r.z() - 1 - z, shortBlockTypes[i], (*_shortCoolerTypes)[i]);
+          place(r.x() - 1 - x, r.y() - 1 - y, r.z() - 1 - z, shortBlockTypes[i], (*_shortCoolerTypes)[i]);
+        }
+      }
+    }
+    submit(1, false);
+  }
+
+  // second tier: exact scores for the shortlist
+  std::pmr::vector<double> exactWeights(&ws.arena);
+  for(Shortlisted & c : std::span<Shortlisted>(shortlist.data(), shortlisted))
+  {
+    c.reactor.invalidate();
+    double w = weighExact(c.reactor, c.s, c.floor, c.features);
+    if(_options.twoTierCalibrate) {
+      exactWeights.push_back(w);
+    }
+    picked.offer(c.reactor, w, generator);
+  }
+
+  if(_options.twoTierCalibrate && !calibration.empty())
+  {
+    // the distribution actually drawn from uses the approximate weight for
+    // everything but the shortlist
+    std::pmr::vector<double> used(calibration.size(), &ws.arena);
+    double usedTotal = 0, exactTotal = 0, relativeError = 0;
+    size_t best = 0;
+    for(size_t c = 0; c < calibration.size(); c++) {
+      used[c] = std::max(calibration[c].first, 0.);
+      exactTotal += std::max(calibration[c].second, 0.);
+      if(calibration[c].second > calibration[best].second) best = c;
+      if(calibration[c].second > 0) {
+        relativeError += fabs(calibration[c].first - calibration[c].second) / calibration[c].second;
+      }
+    }
+    bool bestShortlisted = false;
+    for(const Shortlisted & c : std::span<Shortlisted>(shortlist.data(), shortlisted)) {
+      used[c.id] = std::max(calibration[c.id].second, 0.);
+      bestShortlisted |= (size_t)c.id == best;
+    }
+    for(double u : used) usedTotal += u;
+
+    double tv = 0;
+    if(usedTotal > 0 && exactTotal > 0) {
+      for(size_t c = 0; c < calibration.size(); c++) {
+        tv += fabs(used[c] / usedTotal - std::max(calibration[c].second, 0.) / exactTotal);
+      }
+      tv /= 2;
+    }
+
+    #pragma omp critical(two_tier_stats)
+    {
+      _twoTierStats.steps++;
+      _twoTierStats.candidates += calibration.size();
+      _twoTierStats.bestMissed += !bestShortlisted;
+      _twoTierStats.selectionTV += tv;
+      _twoTierStats.relativeError += relativeError;
+    }
+  }
+
+  // everything may have been discarded by the surrogate
+  if(picked.empty()) {
+    return;
+  }
+
+  // (a swap, so the old r's storage goes on to be reused)
+  std::swap(r, picked.item());
+  if(r.isApproximate()) {
+    r.invalidate();
+  }
+
+  // tabuSet.insert(r);
+  // tabuList.push_back(r);
+
+  // if(tabuList.size() > 10000)
+  // {
+  //   Reactor z = tabuList.front();
+  //   tabuList.pop_front();
+  //   tabuSet.erase(z);
+  // }
+
+}
@@ -0,0 +1,288 @@
+#ifndef __SEARCH_H__
+#define __SEARCH_H__
+
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include "Reactor.h"
+#include "Surrogate.h"
+#include "Bound.h"
+#include "Convergence.h"
+#include "Checkpoint.h"
+#include "Pareto.h"
+#include "Diversity.h"
+#include "Symmetry.h"
+#include "Reservoir.h"
+#include "Arena.h"
+
+typedef float (*objective_fn_t)(Reactor & r, FuelType optimizeFuel);
+
+float objective_fn_efficiency(Reactor & r, FuelType optimizeFuel);
+float objective_fn_output(Reactor & r, FuelType optimizeFuel);
+float objective_fn_cells(Reactor & r, FuelType optimizeFuel);
+
+/** The quantity an objective is ultimately after: effective output per cell,
+  * effective output, or heat adjusted cell count.
+  */
+float objectiveMetric(Reactor & r, FuelType f, objective_fn_t objective_fn);
+
+/** Ceiling on objectiveMetric from a ScoreBound. */
+float objectiveCeiling(const ScoreBound & b, objective_fn_t objective_fn);
+
+/** objective_fn(r, fuels[i]) into out[i] for several fuels at once, from
+  * one evaluation of r (see Reactor::fuelTotals).
+  */
+void objectiveAllFuels(Reactor & r, objective_fn_t objective_fn, const std::vector<FuelType> & fuels, float * out);
+
+/** Objective for a strategy number as on the command line (0: efficiency,
+  * 1: output, 2: cells); nullptr if there is none.
+  */
+objective_fn_t objectiveForStrategy(int strategy);
+/** Inverse of objectiveForStrategy; -1 for anything else. */
+int strategyForObjective(objective_fn_t objective_fn);
+const char * strategyName(int strategy);
+
+class Search;
+
+struct SearchOptions {
+  FuelType fuel = FuelType::LEU235O;
+  objective_fn_t objective = objective_fn_efficiency;
+  // 0: all, 1: passive, 2: active
+  int coolerRestrictions = 1;
+
+  unsigned int threads = 1;
+
+  // repair blocks that a move made inactive before scoring it
+  bool repair = false;
+
+  // two-tier evaluation: every candidate is scored with
+  // Reactor::evaluateApproximate, and only the K best get an exact score
+  int twoTierK = 0;
+  // also score every candidate exactly and keep stats on how much the
+  // approximation would have changed the selection
+  bool twoTierCalibrate = false;
+
+  // per-thread surrogate models pre-filtering candidates
+  bool surrogate = false;
+  float surrogateDiscardBelow = 0.1;
+
+  // stop once the incumbent is this close to the bound; < 0: never
+  float gapTarget = -1;
+
+  StopPolicy stop;
+
+  // track the best design for each of these fuels as well (every exactly
+  // scored candidate is scored against all of them); the threads take turns
+  // driving the search with each. fuel should be one of them: its best is
+  // best(), and stop policies apply to it. empty: just fuel
+  std::vector<FuelType> portfolio;
+
+  // keep a Pareto archive (see ParetoArchive) of every exactly scored
+  // candidate, for fuel. the threads take turns annealing for each of the
+  // three objectives, and random resets restart from a random member of the
+  // archive
+  bool pareto = false;
+
+  // keep the topK best designs (by objective, for fuel) that are pairwise
+  // at least topKMinDistance cells apart, see DiverseArchive; 0: off.
+  // topKMinDistance 0: a tenth of the volume
+  int topK = 0;
+  int topKMinDistance = 0;
+
+  // only consider designs with these symmetries: the initial reactor is
+  // made symmetric, and moves are generated on the fundamental domain (one
+  // cell per orbit) and applied to whole orbits
+  SymmetryGroup::Kind symmetry = SymmetryGroup::Kind::none;
+
+  // polled between steps; the run stops once it's set
+  volatile bool * interrupted = nullptr;
+
+  // hard wall clock limit in seconds (from constructing the Search): run()
+  // returns before it, cutting a step short if it has to; 0: none
+  double timeLimit = 0;
+
+  // called from the search loop (never concurrently) with every new best,
+  // and with the current best when a snapshot is requested; `why` is
+  // "improvement" or "snapshot"
+  std::function<void(Search & search, const char * why)> onNewBest;
+  // polled between steps; set it (e.g. from a signal handler) to have
+  // onNewBest called with the current best right away
+  volatile bool * snapshotRequested = nullptr;
+
+  // progress line on stderr every this many steps; 0: quiet
+  int logEvery = 50;
+
+  // seeds the random number generators (one per thread, plus one for the
+  // search loop), so runs are reproducible
+  unsigned long seed = 0;
+
+  // write a checkpoint here every checkpointEvery steps and when run()
+  // returns; "": never
+  std::string checkpointPath;
+  long checkpointEvery = 500;
+};
+
+/** Pseudo-simulated-annealing search: `threads` reactors evolve in
+  * parallel, the best one seen is kept aside.
+  */
+class Search {
+public:
+  Search(const Reactor & initial, const SearchOptions & options);
+
+  /** Step until the stop policy, the gap target or an interrupt says so. */
+  void run();
+
+  inline Reactor & best() { return _best; }
+  inline long steps() const { return _step; }
+  inline const ScoreBound & bound() const { return _bound; }
+  inline const ConvergenceMonitor & monitor() const { return _monitor; }
+  inline const SearchOptions & options() const { return _options; }
+
+  /** Best design found for options().portfolio[k], and its objective. */
+  inline Reactor & portfolioBest(size_t k) { return _portfolio.best[k]; }
+  inline float portfolioScore(size_t k) const { return _portfolio.scores[k]; }
+
+  /** Non-dominated designs seen (with options().pareto). */
+  inline const ParetoArchive & archive() const { return _archive; }
+
+  /** Symmetries designs are constrained to; nullptr if none. */
+  inline const SymmetryGroup * symmetry() const { return _symmetry; }
+
+  /** The diverse top designs (with options().topK). */
+  inline const DiverseArchive & topK() const { return _topK; }
+
+  /** Optimality gap of a reactor, relative to the bound for this search. */
+  float gap(Reactor & r);
+
+  /** Mean fraction of cells differing between the parallel searches
+    * (-1 with a single one).
+    */
+  float diversity();
+
+  /** Print two-tier calibration and surrogate stats to stderr. */
+  void printStats();
+
+  /** Write the complete search state (every thread's reactor, the best one,
+    * step, RNG states, surrogate models, convergence progress) to `path`.
+    */
+  bool saveCheckpoint(const std::string & path);
+
+  /** Read the settings a checkpoint was taken with (fuel, objective, cooler
+    * restrictions, threads, repair, two-tier, surrogate) into `options` and
+    * its best reactor into `best`, to construct the Search that resumes it.
+    */
+  static bool checkpointSettings(const std::string & path, SearchOptions & options, Reactor & best);
+
+  /** Threads (at most options.threads, at least 1) whose reactors fit in
+    * `budget` bytes for a `volume` cell reactor. Each thread keeps its
+    * current reactor, the candidate, the picked one, a calibration copy and
+    * a best one per portfolio fuel; the overall best ones are shared.
+    */
+  static unsigned int threadsWithinMemory(largecount_t volume, const SearchOptions & options, size_t budget);
+
+  /** Continue exactly where a checkpoint left off. The Search must have been
+    * constructed from checkpointSettings.
+    */
+  bool resume(const std::string & path);
+
+private:
+  void _stepRnd(int j, int idx);
+
+  /** Fuel that thread j anneals for at step idx. */
+  FuelType _drivingFuel(int j, long idx) const;
+
+  /** Objective that thread j anneals for at step idx. */
+  objective_fn_t _drivingObjective(int j, long idx) const;
+
+  /** Called by thread j with every exactly scored candidate. */
+  void _observeCandidate(int j, Reactor & c);
+  /** Fold the per-thread portfolio bests into _portfolio. */
+  bool _mergePortfolio();
+
+  static void _saveSettings(CheckpointWriter & out, const SearchOptions & options);
+  static bool _loadSettings(CheckpointReader & in, SearchOptions & options);
+
+  inline bool _pastDeadline() const {
+    return _options.timeLimit > 0 && std::chrono::steady_clock::now() >= _deadline;
+  }
+
+  SearchOptions _options;
+  const std::vector<CoolerType> * _shortCoolerTypes;
+  const SymmetryGroup * _symmetry;
+
+  std::vector<Reactor> _reactors;
+  std::vector<std::default_random_engine> _generators;
+  // for the search loop itself
+  std::default_random_engine _generator;
+  Reactor _best;
+  long _step;
+
+  ScoreBound _bound;
+  float _ceiling;
+
+  ConvergenceMonitor _monitor;
+
+  std::chrono::steady_clock::time_point _deadline;
+  // longest step so far, seconds
+  double _longestStep;
+
+  // a two-tier shortlist entry (see _stepRnd)
+  struct Shortlisted {
+    Reactor reactor;
+    double weight;
+    float s;
+    bool floor;
+    int id;
+    Surrogate::features_t features;
+  };
+
+  /** What one thread's steps work in. Reactors here are recycled (copy
+    * assignment and swaps reuse their buffers), everything else a step
+    * needs comes from the arena, which is reset at the start of each step;
+    * so once warmed up, steps don't touch the global heap.
+    */
+  struct Workspace {
+    Arena arena;
+    Reactor candidate;
+    // exactly scored copy of a candidate, for --two-tier-calibrate
+    Reactor calibrationCopy;
+    WeightedReservoir<Reactor> picked;
+    std::vector<CellChange> changes;
+    std::vector<coord_t> edits;
+    std::vector<Shortlisted> shortlist;
+  };
+  std::vector<std::unique_ptr<Workspace> > _workspaces;
+  // global allocations made by each thread's steps after the warm-up
+  std::vector<uint64_t> _stepAllocations;
+
+  std::vector<Surrogate> _surrogates;
+
+  struct Portfolio {
+    std::vector<float> scores;
+    std::vector<Reactor> best;
+  };
+  Portfolio _portfolio;
+  // improvements on _portfolio found by each thread during the current step
+  std::vector<Portfolio> _threadPortfolios;
+
+  ParetoArchive _archive;
+  DiverseArchive _topK;
+
+  struct TwoTierStats {
+    long steps = 0;
+    long candidates = 0;
+    // steps where the exactly best candidate didn't make the shortlist
+    long bestMissed = 0;
+    // sum over steps of the total variation distance between the selection
+    // distribution actually used and the all-exact one
+    double selectionTV = 0;
+    // sum over candidates of |approx - exact| / exact weight
+    double relativeError = 0;
+  } _twoTierStats;
+};
+
+#endif
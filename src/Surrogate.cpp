@@ -0,0 +1,138 @@
+#include "Surrogate.h"
+
+#include <cmath>
+#include <algorithm>
+
+// samples before the model is trusted to discard anything
+#define SURROGATE_WARMUP 2000
+#define SURROGATE_LEARNING_RATE 0.05f
+#define SURROGATE_MSE_DECAY 0.999f
+
+Surrogate::Surrogate(float discardBelow) {
+  _weights.fill(0);
+  _discardLevel = logf(discardBelow);
+  _mse = 0;
+}
+
+static inline int blockClass(BlockType bt) {
+  switch (bt) {
+    case BlockType::reactorCell: return 1;
+    case BlockType::moderator: return 2;
+    case BlockType::cooler: return 3;
+    default: return 0;
+  }
+}
+
+void Surrogate::extractFeatures(Reactor & parent, Reactor & child, const std::vector<coord_t> & edits, features_t & out) {
+  out.fill(0);
+
+  int n = 0;
+  float maxDistance = std::max({parent.x(), parent.y(), parent.z()}) / 2.0f;
+
+  for (const coord_t & c : edits) {
+    BlockType before = parent.blockTypeAt(UNPACK(c));
+    BlockType after = child.blockTypeAt(UNPACK(c));
+    CoolerType ct = child.coolerTypeAt(UNPACK(c));
+
+    if (before == after && parent.coolerTypeAt(UNPACK(c)) == ct) {
+      continue;
+    }
+    n++;
+
+    // 0 - 3: block placed, 4 - 7: block replaced
+    out[blockClass(after)] += 1;
+    out[4 + blockClass(before)] += 1;
+
+    // 8 - 13: neighbourhood as the parent sees it
+    out[8] += parent.reactorCellsAdjacentTo(UNPACK(c)) / 6.0f;
+    out[9] += parent.activeModeratorsAdjacentTo(UNPACK(c)) / 6.0f;
+    out[10] += parent.activeCoolersAdjacentTo(UNPACK(c)) / 6.0f;
+    out[11] += parent.reactorCasingsAdjacentTo(UNPACK(c)) / 3.0f;
+    out[12] += parent.wastedAt(UNPACK(c));
+    out[13] += parent.coolingContributionAt(UNPACK(c)) > 0;
+
+    // 14 - 15: cooler tier context of what's placed
+    if (after == BlockType::cooler) {
+      out[14] += parent.coolerTypeActiveAt(UNPACK(c), ct);
+      out[15] += parent.coolingContributionAt(UNPACK(c)) > 0 ? 0 : 1;
+    }
+
+    // 16: distance to casing
+    int d = std::min({
+      (int)c[0], parent.x() - 1 - c[0],
+      (int)c[1], parent.y() - 1 - c[1],
+      (int)c[2], parent.z() - 1 - c[2]
+    });
+    out[16] += d / std::max(maxDistance, 1.0f);
+
+    // 17: power of the cell being overwritten
+    out[17] += parent.powerContributionAt(UNPACK(c)) / 14.0f;
+  }
+
+  if (n) {
+    for (int i = 0; i < 18; i++) {
+      out[i] /= n;
+    }
+  }
+
+  out[18] = n / 8.0f;
+  out[19] = 1; // bias
+}
+
+float Surrogate::predict(const features_t & f) const {
+  float r = 0;
+  for (int i = 0; i < NUM_FEATURES; i++) {
+    r += _weights[i] * f[i];
+  }
+  return r;
+}
+
+void Surrogate::train(const features_t & f, float target) {
+  if (!std::isfinite(target)) {
+    return;
+  }
+
+  float err = target - predict(f);
+
+  float norm = 1e-3;
+  for (int i = 0; i < NUM_FEATURES; i++) {
+    norm += f[i] * f[i];
+  }
+  for (int i = 0; i < NUM_FEATURES; i++) {
+    _weights[i] += SURROGATE_LEARNING_RATE * err * f[i] / norm;
+  }
+
+  _mse = stats.trained ? SURROGATE_MSE_DECAY * _mse + (1 - SURROGATE_MSE_DECAY) * err * err : err * err;
+  stats.trained++;
+}
+
+bool Surrogate::shouldDiscard(const features_t & f) const {
+  if (stats.trained < SURROGATE_WARMUP) {
+    return false;
+  }
+  return predict(f) + 2 * rmse() < _discardLevel;
+}
+
+Surrogate::Stats & Surrogate::Stats::operator+=(const Stats & o) {
+  seen += o.seen;
+  discarded += o.discarded;
+  audited += o.audited;
+  hits += o.hits;
+  misses += o.misses;
+  trained += o.trained;
+  evalSeconds += o.evalSeconds;
+  evals += o.evals;
+  featureSeconds += o.featureSeconds;
+  return *this;
+}
+
+void Surrogate::save(CheckpointWriter & out) const {
+  out.put(_weights);
+  out.put(_discardLevel);
+  out.put(_mse);
+  out.put(stats);
+}
+
+bool Surrogate::load(CheckpointReader & in) {
+  return in.get(_weights) && in.get(_discardLevel) && in.get(_mse) && in.get(stats);
+}
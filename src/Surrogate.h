@@ -0,0 +1,73 @@
+#ifndef __SURROGATE_H__
+#define __SURROGATE_H__
+
+#include <array>
+#include <vector>
+#include <cmath>
+
+#include "Reactor.h"
+#include "Checkpoint.h"
+
+/** Online linear model predicting how a move changes the objective, used to
+  * throw away clearly bad candidates before they are evaluated.
+  *
+  * Features are local to the edited cells (block before / after, neighbour
+  * counts, cooler context, distance to the casing); the target is
+  * log(objective(child) / objective(parent)). Trained with normalised LMS on
+  * the exact evaluations the search performs anyway.
+  */
+class Surrogate {
+public:
+  static const int NUM_FEATURES = 20;
+  typedef std::array<float, NUM_FEATURES> features_t;
+
+  /** @param discardBelow candidates predicted to keep less than this
+    *        fraction of the parent's objective (with a margin of two RMSE)
+    *        are discarded once the model is warmed up.
+    */
+  Surrogate(float discardBelow = 0.1);
+
+  /** Features of the move that turned `parent` into `child`.
+    *
+    * @note `parent` must be evaluated; `child` is only read.
+    */
+  static void extractFeatures(Reactor & parent, Reactor & child, const std::vector<coord_t> & edits, features_t & out);
+
+  float predict(const features_t & f) const;
+  void train(const features_t & f, float target);
+
+  bool shouldDiscard(const features_t & f) const;
+
+  /** Whether an exact log ratio means the candidate really was bad. */
+  inline bool isBad(float target) const { return target < _discardLevel; }
+
+  inline float rmse() const { return _mse > 0 ? sqrtf(_mse) : 0; }
+
+  struct Stats {
+    long seen = 0;
+    long discarded = 0;
+    // discarded candidates that were evaluated anyway to measure accuracy
+    long audited = 0;
+    // audited discards that really were bad / that weren't
+    long hits = 0;
+    long misses = 0;
+    long trained = 0;
+    double evalSeconds = 0;
+    long evals = 0;
+    double featureSeconds = 0;
+
+    Stats & operator+=(const Stats & o);
+  };
+
+  Stats stats;
+
+  void save(CheckpointWriter & out) const;
+  bool load(CheckpointReader & in);
+
+private:
+  std::array<float, NUM_FEATURES> _weights;
+  float _discardLevel;
+  float _mse;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "Symmetry.h"
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+
+SymmetryGroup::SymmetryGroup(index_t x, index_t y, index_t z, Kind kind) : _d({x, y, z}) {
+  const std::array<int, 3> d = {x, y, z};
+  const std::array<int64_t, 3> stride = {(int64_t)y * z, z, 1};
+  std::array<int, 3> axes = {0, 1, 2};
+
+  // std::next_permutation starts from the identity, so element 0 is it
+  do {
+    // output axis k reads input axis axes[k]; only equal lengths can swap
+    if (d[axes[0]] != d[0] || d[axes[1]] != d[1] || d[axes[2]] != d[2]) {
+      continue;
+    }
+    if (kind != Kind::full && (axes[0] != 0 || axes[1] != 1 || axes[2] != 2)) {
+      continue;
+    }
+
+    int mirrors = kind == Kind::none ? 1 : kind == Kind::mirrorX ? 2 : 8;
+    for (int mirror = 0; mirror < mirrors; mirror++) {
+      Element e = {0, {0, 0, 0}, _d};
+      for (int k = 0; k < 3; k++) {
+        if (d[k] == 1) {
+          continue;
+        }
+        if ((mirror >> k) & 1) {
+          e.base += (d[k] - 1) * stride[axes[k]];
+          e.step[k] = -stride[axes[k]];
+        }
+        else {
+          e.step[k] = stride[axes[k]];
+        }
+      }
+
+      // mirroring a length 1 axis does nothing; skip the duplicates
+      if (std::find(_elements.begin(), _elements.end(), e) == _elements.end()) {
+        _elements.push_back(e);
+      }
+    }
+  } while (std::next_permutation(axes.begin(), axes.end()));
+}
+
+SymmetryGroup::Orbit SymmetryGroup::orbit(uint32_t n) const {
+  const uint32_t yz = _d[1] * _d[2];
+  const index_t i = n / yz, j = n % yz / _d[2], k = n % _d[2];
+
+  Orbit ret;
+  ret.count = 0;
+  for (const Element & e : _elements) {
+    // (insertion sort, dropping repeats: orbits are tiny)
+    uint32_t m = e.at(i, j, k);
+    int p = ret.count;
+    while (p > 0 && ret.cells[p - 1] > m) {
+      p--;
+    }
+    if (p > 0 && ret.cells[p - 1] == m) {
+      continue;
+    }
+    std::copy_backward(ret.cells.begin() + p, ret.cells.begin() + ret.count, ret.cells.begin() + ret.count + 1);
+    ret.cells[p] = m;
+    ret.count++;
+  }
+  return ret;
+}
+
+uint32_t SymmetryGroup::representative(uint32_t n) const {
+  const uint32_t yz = _d[1] * _d[2];
+  const index_t i = n / yz, j = n % yz / _d[2], k = n % _d[2];
+  uint32_t ret = n;
+  for (const Element & e : _elements) {
+    ret = std::min(ret, e.at(i, j, k));
+  }
+  return ret;
+}
+
+const std::vector<uint32_t> & SymmetryGroup::representatives() const {
+  std::call_once(_listed, [this]() {
+    uint32_t n = 0;
+    for (index_t i = 0; i < _d[0]; i++) {
+      for (index_t j = 0; j < _d[1]; j++) {
+        for (index_t k = 0; k < _d[2]; k++, n++) {
+          bool smallest = true;
+          for (size_t g = 1; smallest && g < _elements.size(); g++) {
+            smallest = _elements[g].at(i, j, k) >= n;
+          }
+          if (smallest) {
+            _representatives.push_back(n);
+          }
+        }
+      }
+    }
+  });
+  return _representatives;
+}
+
+bool SymmetryGroup::isSymmetric(Reactor & r) const {
+  const uint32_t volume = r.volume();
+  for (size_t g = 1; g < _elements.size(); g++) {
+    Walk w(_elements[g]);
+    for (uint32_t n = 0; n < volume; n++, w.next()) {
+      if (r.cellCode(*w) != r.cellCode(n)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void SymmetryGroup::symmetrize(Reactor & r) const {
+  const uint32_t volume = r.volume();
+  for (uint32_t n = 0; n < volume; n++) {
+    uint32_t from = representative(n);
+    if (from != n) {
+      r.setCellCode(n, r.cellCode(from));
+    }
+  }
+}
+
+bool symmetryKindForName(const std::string & name, SymmetryGroup::Kind & out) {
+  for (int k = 0; k <= static_cast<int>(SymmetryGroup::Kind::full); k++) {
+    if (name == symmetryKindName(static_cast<SymmetryGroup::Kind>(k))) {
+      out = static_cast<SymmetryGroup::Kind>(k);
+      return true;
+    }
+  }
+  return false;
+}
+
+const char * symmetryKindName(SymmetryGroup::Kind kind) {
+  switch (kind) {
+    case SymmetryGroup::Kind::none:
+      return "none";
+    case SymmetryGroup::Kind::mirrorX:
+      return "x";
+    case SymmetryGroup::Kind::mirrorXYZ:
+      return "xyz";
+    default:
+      return "full";
+  }
+}
+
+const SymmetryGroup & SymmetryGroup::forDimensions(index_t x, index_t y, index_t z, Kind kind) {
+  // a search asks for the same group over and over; don't take the lock
+  // for that
+  const std::array<int, 4> key = {x, y, z, static_cast<int>(kind)};
+  thread_local std::array<int, 4> lastKey = {0, 0, 0, 0};
+  thread_local const SymmetryGroup * last = nullptr;
+  if (last && lastKey == key) {
+    return *last;
+  }
+
+  static std::mutex mutex;
+  static std::map<std::array<int, 4>, std::unique_ptr<SymmetryGroup> > groups;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::unique_ptr<SymmetryGroup> & g = groups[key];
+  if (!g) {
+    g.reset(new SymmetryGroup(x, y, z, kind));
+  }
+  lastKey = key;
+  last = g.get();
+  return *g;
+}
+
+size_t canonicalElement(Reactor & r) {
+  const SymmetryGroup & group = SymmetryGroup::forDimensions(r.x(), r.y(), r.z());
+  const size_t volume = r.volume();
+
+  static thread_local std::vector<uint8_t> codes;
+  codes.resize(volume);
+  for (size_t n = 0; n < volume; n++) {
+    codes[n] = r.cellCode(n);
+  }
+
+  size_t best = 0;
+  for (size_t g = 1; g < group.size(); g++) {
+    SymmetryGroup::Walk p(group.element(g)), b(group.element(best));
+    for (size_t n = 0; n < volume; n++, p.next(), b.next()) {
+      uint8_t cg = codes[*p], cb = codes[*b];
+      if (cg != cb) {
+        if (cg < cb) {
+          best = g;
+        }
+        break;
+      }
+    }
+  }
+  return best;
+}
+
+size_t canonicalHash(Reactor & r) {
+  const SymmetryGroup::Element & e = SymmetryGroup::forDimensions(r.x(), r.y(), r.z()).element(canonicalElement(r));
+
+  // FNV-1a over the dimensions and the canonical cell codes
+  size_t h = 14695981039346656037ULL;
+  auto mix = [&](uint8_t v) {
+    h ^= v;
+    h *= 1099511628211ULL;
+  };
+  for (index_t d : { r.x(), r.y(), r.z() }) {
+    for (int b = 0; b < 4; b++) {
+      mix(static_cast<uint32_t>(d) >> (8 * b));
+    }
+  }
+  SymmetryGroup::Walk w(e);
+  for (largecount_t n = 0; n < r.volume(); n++, w.next()) {
+    mix(r.cellCode(*w));
+  }
+  return h;
+}
@@ -0,0 +1,139 @@
+#ifndef __SYMMETRY_H__
+#define __SYMMETRY_H__
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <string>
+
+#include "Reactor.h"
+
+/** Symmetries of an x * y * z box: mirroring along any axis, combined with
+  * any permutation of axes of equal length. 8 elements if all dimensions
+  * differ, 16 if two are equal, 48 for a cube.
+  *
+  * Every element is a permutation of cell indices: cell n of the transformed
+  * reactor is cell element(g)[n] of the original (Reactor::cellIndex).
+  * Element 0 is the identity. Elements are kept as the affine maps they are
+  * and orbits worked out when asked for, so a group takes next to no memory
+  * whatever the volume (only representatives() has an entry per orbit).
+  */
+class SymmetryGroup {
+public:
+  /** Which symmetries: just the identity, mirroring along x, mirroring
+    * along any axis, or everything above.
+    */
+  enum struct Kind {
+    none = 0,
+    mirrorX,
+    mirrorXYZ,
+    full,
+  };
+
+  struct Element {
+    // cell (i, j, k) of the image is cell base + i * step[0] + j * step[1]
+    // + k * step[2] of the original (steps along length 1 axes are 0)
+    int64_t base;
+    std::array<int64_t, 3> step;
+    std::array<index_t, 3> d;
+
+    inline uint32_t at(index_t i, index_t j, index_t k) const {
+      return static_cast<uint32_t>(base + i * step[0] + j * step[1] + k * step[2]);
+    }
+    inline uint32_t operator[](uint32_t n) const {
+      const uint32_t yz = d[1] * d[2];
+      return at(n / yz, n % yz / d[2], n % d[2]);
+    }
+    inline bool operator==(const Element & b) const {
+      return base == b.base && step == b.step;
+    }
+  };
+
+  /** element[0], element[1], ... in turn, without a division per cell. */
+  class Walk {
+  public:
+    Walk(const Element & e) : _e(e), _j(0), _k(0), _row(e.base), _m(e.base) {}
+
+    inline uint32_t operator*() const { return static_cast<uint32_t>(_m); }
+    inline void next() {
+      if (++_k < _e.d[2]) {
+        _m += _e.step[2];
+        return;
+      }
+      _k = 0;
+      if (++_j < _e.d[1]) {
+        _row += _e.step[1];
+      }
+      else {
+        _j = 0;
+        _row += _e.step[0] - (_e.d[1] - 1) * _e.step[1];
+      }
+      _m = _row;
+    }
+
+  private:
+    const Element & _e;
+    index_t _j, _k;
+    int64_t _row, _m;
+  };
+
+  /** At most one cell per element, smallest first. */
+  struct Orbit {
+    std::array<uint32_t, 48> cells;
+    int count;
+
+    inline const uint32_t * begin() const { return cells.data(); }
+    inline const uint32_t * end() const { return cells.data() + count; }
+    inline size_t size() const { return count; }
+    inline uint32_t operator[](size_t i) const { return cells[i]; }
+  };
+
+  /** Shared, built on first use for each set of dimensions. */
+  static const SymmetryGroup & forDimensions(index_t x, index_t y, index_t z, Kind kind = Kind::full);
+
+  inline size_t size() const { return _elements.size(); }
+  inline const Element & element(size_t g) const { return _elements[g]; }
+
+  /** Cells that some element maps cell n to (a symmetric reactor has the
+    * same contents in all of them).
+    */
+  Orbit orbit(uint32_t n) const;
+  uint32_t representative(uint32_t n) const;
+  /** Smallest cell of every orbit: the fundamental domain. (Listed on
+    * first use.)
+    */
+  const std::vector<uint32_t> & representatives() const;
+
+  /** Whether r is its own image under every element. */
+  bool isSymmetric(Reactor & r) const;
+  /** Copy every orbit's representative over the rest of it. */
+  void symmetrize(Reactor & r) const;
+
+private:
+  SymmetryGroup(index_t x, index_t y, index_t z, Kind kind);
+
+  std::array<index_t, 3> _d;
+  std::vector<Element> _elements;
+  mutable std::once_flag _listed;
+  mutable std::vector<uint32_t> _representatives;
+};
+
+/** "none", "x", "xyz" or "full"; false if it's none of them. */
+bool symmetryKindForName(const std::string & name, SymmetryGroup::Kind & out);
+const char * symmetryKindName(SymmetryGroup::Kind kind);
+
+/** Index (in r's SymmetryGroup) of the element that maps r to its canonical
+  * form: the image whose cellCode sequence is lexicographically smallest.
+  * Compares images lazily, so it's usually about one pass over the cells
+  * per element.
+  */
+size_t canonicalElement(Reactor & r);
+
+/** Hash of r's canonical form (without building it): the same for every
+  * reactor that's a mirror image / rotation of r. DiverseArchive turns
+  * such duplicates of its members away by it.
+  */
+size_t canonicalHash(Reactor & r);
+
+#endif
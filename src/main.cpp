@@ -18,270 +18,161 @@
 #include <omp.h>
 
 #include "Reactor.h"
+#include "Search.h"
+#include "Incumbent.h"
+#include "Batch.h"
+#include "FuelRanking.h"
 
 #define DIM_X 5
 #define DIM_Y 5
 #define DIM_Z 5
 #define OPTIMIZE_FUEL FuelType::LEU235O
 
-std::default_random_engine generator;
-
-const std::vector<BlockType> shortBlockTypes = {
-  BlockType::air, //0
-  BlockType::reactorCell, //1
-  BlockType::moderator, //2
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-  // BlockType::cooler,
-
-};
-
-const std::vector<CoolerType> shortCoolerTypes_all = {
-  CoolerType::air,
-  CoolerType::air,
-  CoolerType::air,
-  // CoolerType::water,
-  // CoolerType::redstone,
-  // CoolerType::quartz,
-  // CoolerType::gold,
-  // CoolerType::glowstone,
-  // CoolerType::lapis,
-  // CoolerType::diamond,
-  // CoolerType::liquidHelium,
-  // CoolerType::enderium,
-  // CoolerType::cryotheum,
-  // CoolerType::iron,
-  // CoolerType::emerald,
-  // CoolerType::copper,
-  // CoolerType::tin,
-  // CoolerType::magnesium,
-  // CoolerType::activeCryotheum,
-};
-
-const std::vector<CoolerType> shortCoolerTypes_active = {
-  CoolerType::air,
-  CoolerType::air,
-  CoolerType::air,
-  // CoolerType::water,
-  // CoolerType::redstone,
-  // CoolerType::quartz,
-  // CoolerType::gold,
-  // CoolerType::glowstone,
-  // CoolerType::lapis,
-  // CoolerType::diamond,
-  // CoolerType::liquidHelium,
-  // CoolerType::enderium,
-  // CoolerType::cryotheum,
-  // CoolerType::iron,
-  // CoolerType::emerald,
-  // CoolerType::copper,
-  // CoolerType::tin,
-  // CoolerType::magnesium,
-  // CoolerType::activeCryotheum,
-};
-
-const std::vector<CoolerType> shortCoolerTypes_passive = {
-  CoolerType::air,
-  CoolerType::air,
-  CoolerType::air,
-  // CoolerType::water,
-  // CoolerType::redstone,
-  // CoolerType::quartz,
-  // CoolerType::gold,
-  // CoolerType::glowstone,
-  // CoolerType::lapis,
-  // CoolerType::diamond,
-  // CoolerType::liquidHelium,
-  // CoolerType::enderium,
-  // CoolerType::cryotheum,
-  // CoolerType::iron,
-  // CoolerType::emerald,
-  // CoolerType::copper,
-  // CoolerType::tin,
-  // CoolerType::magnesium,
-  // CoolerType::activeCryotheum,
-};
-
-const std::vector<CoolerType> * shortCoolerTypes = &shortCoolerTypes_passive;
-
-float objective_fn_efficiency(Reactor & r, FuelType optimizeFuel)
-{
-  return (1e-10 + r.effectivePowerGenerated(optimizeFuel) / std::max(r.totalCells(), (int_fast32_t)1) + r.effectivePowerGenerated(optimizeFuel) / 100000.)
-          //- (r.heatGenerated(OPTIMIZE_FUEL) > 0 ? r.effectivePowerGenerated(OPTIMIZE_FUEL) : 0))
-          / (0.1 + r.inactiveBlocks() * r.inactiveBlocks() + (r.heatGenerated(optimizeFuel) > 0 ? r.heatGenerated(optimizeFuel) / 10000 : 0));
-          // - r.heatGenerated(FuelType::air) / 10;
+volatile bool got_sigint = false;
+void catch_sigint(int sig) {
+  got_sigint = true;
 }
 
-float objective_fn_output(Reactor & r, FuelType optimizeFuel)
-{
-  return (1e-10 + r.effectivePowerGenerated(optimizeFuel))
-          / (0.1 + r.inactiveBlocks() * r.inactiveBlocks() + (r.heatGenerated(optimizeFuel) > 0 ? r.heatGenerated(optimizeFuel) / 10000 : 0))
-          - r.heatGenerated(FuelType::air) / 10;
+// (no SIGUSR1 on Windows, so no snapshots on request there)
+#ifdef SIGUSR1
+volatile bool got_sigusr1 = false;
+void catch_sigusr1(int sig) {
+  got_sigusr1 = true;
 }
+#endif
 
-float objective_fn_cells(Reactor & r, FuelType optimizeFuel)
+/** Pull `--name` / `--name=value` flags out of argv, leaving the positional
+  * arguments in place (argc is updated).
+  */
+std::map<std::string, std::string> extract_flags(int & argc, char ** argv)
 {
-  float mult = r.heatGenerated(optimizeFuel) <= 0 ? 1 : (r.heatGenerated(FuelType::air) / (r.heatGenerated(FuelType::air) - r.heatGenerated(optimizeFuel)));
-  return (1e-10 + r.totalCells() * mult)
-          / (1 + r.inactiveBlocks() * r.inactiveBlocks()); // + (r.heatGenerated(optimizeFuel) <= 0 ? 0 : (r.heatGenerated(optimizeFuel)) / 50000));
+  std::map<std::string, std::string> flags;
+  int n = 1;
+  for(int i = 1; i < argc; i++)
+  {
+    std::string a(argv[i]);
+    if(a.size() > 2 && a.compare(0, 2, "--") == 0)
+    {
+      size_t eq = a.find('=');
+      if(eq == std::string::npos) {
+        flags[a.substr(2)] = "";
+      }
+      else {
+        flags[a.substr(2, eq - 2)] = a.substr(eq + 1);
+      }
+    }
+    else
+    {
+      argv[n++] = argv[i];
+    }
+  }
+  argc = n;
+  return flags;
 }
 
-#define OBJECTIVE_FN objective_fn_efficiency
-
-std::set<Reactor> tabuSet;
-std::deque<Reactor> tabuList;
-
-void step_rnd(Reactor & r, int idx, FuelType f, decltype(OBJECTIVE_FN) objective_fn)
+int main(int argc, char ** argv)
 {
-  std::vector<Reactor> steps;
-  std::vector<double> step_weights;
+  std::map<std::string, std::string> flags = extract_flags(argc, argv);
 
-  // principled extension
-  std::vector<std::tuple<coord_t, BlockType, CoolerType, float> > principledActions;
+  SearchOptions options;
 
-  std::set<coord_t> principledLocations = r.suggestPrincipledLocations();
-  for(const coord_t & ploc : principledLocations)
-  {
-    BlockType bt = r.blockTypeAt(UNPACK(ploc));
-    // if (bt != BlockType::reactorCell && bt != BlockType::moderator) {
-      auto suggestedBlocks = r.suggestedBlocksAt(UNPACK(ploc), f);
-      for (const auto & tpl : suggestedBlocks)
-      {
-        principledActions.push_back(std::tuple_cat(std::make_tuple(ploc), tpl));
-      }
-    // }
+  if (flags.count("repair")) {
+    options.repair = true;
   }
 
-  if(principledActions.size())
-  {
-    // #pragma omp parallel for
-    for(int m = 0; m < 100; m++)
-    {
-      Reactor r1 = r;
-
-      int nn = std::uniform_int_distribution<int>(1, 2)(generator);
-      float s = 0;
-      for(int n = 0; n < nn; n++)
-      {
-        int i = std::uniform_int_distribution<int>(0, principledActions.size() - 1)(generator);
-        auto theAction = principledActions[i];
-
-        coord_t where = std::get<0>(theAction);
-        BlockType bt = std::get<1>(theAction);
-        CoolerType ct = std::get<2>(theAction);
-        float _s = std::get<3>(theAction);
-
-        int x = where[0];
-        int y = where[1];
-        int z = where[2];
-
-        r1.setCell(UNPACK(where), bt, ct);
-        if(r.x() > 2 && r.y() > 2 && r.z() > 2 && idx < 2000) {
-          r1.setCell(r.x() - 1 - x, y, z, bt, ct);
-          r1.setCell(x, y, r.z() - 1 - z, bt, ct);
-          r1.setCell(r.x() - 1 - x, y, r.z() - 1 - z, bt, ct);
-          r1.setCell(x, r.y() - 1 - y, z, bt, ct);
-          r1.setCell(r.x() - 1 - x, r.y() - 1 - y, z, bt, ct);
-          r1.setCell(x, r.y() - 1 - y, r.z() - 1 - z, bt, ct);
-          r1.setCell(r.x() - 1 - x, r.y() - 1 - y, r.z() - 1 - z, bt, ct);
-        }
-        s += _s;
-      }
-      double score = std::max(pow(objective_fn(r1, f), 1. + (float)(idx % 10000) / 5000), 0.01);
-      // #pragma omp critical
-      {
-        // if(!tabuSet.count(r1) || m == 0) {
-          steps.push_back(r1);
-          step_weights.push_back(score * s);
-        // }
-      }
-    }
+  if (flags.count("two-tier")) {
+    options.twoTierK = flags["two-tier"].empty() ? 10 : atoi(flags["two-tier"].c_str());
   }
 
-  // #pragma omp parallel for
-  for(int m = 0; m < 50; m++)
-  {
-    int x, y, z, i;
-
-    Reactor r1 = r;
-
-    int nn = std::uniform_int_distribution<int>(1, 4)(generator);;
-    float s = 0;
-    for(int n = 0; n < nn; n++) {
-      x = std::uniform_int_distribution<int>(0, r.x() - 1)(generator);
-      y = std::uniform_int_distribution<int>(0, r.y() - 1)(generator);
-      z = std::uniform_int_distribution<int>(0, r.z() - 1)(generator);
-      i = std::uniform_int_distribution<int>(0, shortCoolerTypes->size() - 1)(generator);
-      // if (shortBlockTypes[i] != BlockType::reactorCell && r.blockTypeAt(x, y, z) != BlockType::reactorCell && r.blockTypeAt(x, y, z) != BlockType::moderator )
-      if(1)
-      {
-        r1.setCell(x, y, z, shortBlockTypes[i], (*shortCoolerTypes)[i]);
-        if(r.x() > 2 && r.y() > 2 && r.z() > 2 && idx < 2000) {
-          r1.setCell(r.x() - 1 - x, y, z, shortBlockTypes[i], (*shortCoolerTypes)[i]);
-          r1.setCell(x, y, r.z() - 1 - z, shortBlockTypes[i], (*shortCoolerTypes)[i]);
-          r1.setCell(r.x() - 1 - x, y, r.z() - 1 - z, shortBlockTypes[i], (*shortCoolerTypes)[i]);
-          r1.setCell(x, r.y() - 1 - y, z, shortBlockTypes[i], (*shortCoolerTypes)[i]);
-          r1.setCell(r.x() - 1 - x, r.y() - 1 - y, z, shortBlockTypes[i], (*shortCoolerTypes)[i]);
-          r1.setCell(x, r.y() - 1 - y, r.z() - 1 - z, shortBlockTypes[i], (*shortCoolerTypes)[i]);
-          r1.setCell(r.x() - 1 - x, r.y() - 1 - y, r.z() - 1 - z, shortBlockTypes[i], (*shortCoolerTypes)[i]);
-        }
-      }
-    }
+  if (flags.count("two-tier-calibrate")) {
+    options.twoTierCalibrate = true;
+  }
 
-    double score = pow(objective_fn(r1, f), 1. + (float)(idx % 10000) / 5000);
-    // #pragma omp critical
-    {
-    //   if(!tabuSet.count(r1) || m == 0) {
-        steps.push_back(r1);
-        step_weights.push_back(score);
-    //   }
+  if (flags.count("pareto")) {
+    options.pareto = true;
+  }
+
+  if (flags.count("symmetry")) {
+    if (!symmetryKindForName(flags["symmetry"], options.symmetry)) {
+      fprintf(stderr, "--symmetry is one of none, x, xyz, full\n");
+      return 1;
     }
   }
 
-  int ret_idx = std::discrete_distribution<int>(step_weights.begin(), step_weights.end())(generator);
-  r = steps[ret_idx];
+  if (flags.count("top-k")) {
+    options.topK = flags["top-k"].empty() ? 10 : atoi(flags["top-k"].c_str());
+  }
+  if (flags.count("min-distance")) {
+    options.topKMinDistance = atoi(flags["min-distance"].c_str());
+  }
 
-  // tabuSet.insert(r);
-  // tabuList.push_back(r);
+  if (flags.count("gap")) {
+    options.gapTarget = atof(flags["gap"].c_str());
+  }
 
-  // if(tabuList.size() > 10000)
-  // {
-  //   Reactor z = tabuList.front();
-  //   tabuList.pop_front();
-  //   tabuSet.erase(z);
-  // }
+  if (flags.count("surrogate")) {
+    options.surrogate = true;
+    if (!flags["surrogate"].empty()) {
+      options.surrogateDiscardBelow = atof(flags["surrogate"].c_str());
+    }
+  }
 
-}
+  auto applyStopFlags = [&](StopPolicy & stop) {
+    if (flags.count("max-steps")) {
+      stop.maxSteps = atol(flags["max-steps"].c_str());
+    }
+    if (flags.count("max-time")) {
+      stop.maxSeconds = atof(flags["max-time"].c_str());
+    }
+    if (flags.count("target")) {
+      stop.target = atof(flags["target"].c_str());
+    }
+    if (flags.count("stagnation")) {
+      stop.stagnationWindow = atol(flags["stagnation"].c_str());
+    }
+  };
 
-#define step step_rnd
+  if (flags.count("seed")) {
+    options.seed = strtoul(flags["seed"].c_str(), nullptr, 10);
+  }
 
-volatile bool got_sigint = false;
-void catch_sigint(int sig) {
-  got_sigint = true;
-}
+  signal(SIGINT, catch_sigint);
+  options.interrupted = &got_sigint;
+
+  // rank existing designs (the positional arguments: files or directories)
+  // by the fuel they run best on
+  if (flags.count("rank-fuels")) {
+    std::vector<std::string> paths(argv + 1, argv + argc);
+    std::vector<std::string> files = collectDesigns(paths);
+    std::string csv = flags.count("rank-out") ? flags["rank-out"] : "-";
+    return rankFuels(files, csv) ? 1 : 0;
+  }
 
-int main(int argc, char ** argv)
-{
+  // batch mode: everything in the job file, sharing all cores
+  if (flags.count("jobs")) {
+    std::vector<Job> jobs;
+    if (!readJobFile(flags["jobs"], jobs)) {
+      return 1;
+    }
+    int cores = flags.count("cores") ? atoi(flags["cores"].c_str()) : omp_get_num_procs();
+    std::string outDir = flags.count("jobs-out") ? flags["jobs-out"] : "jobs";
+    fprintf(stderr, "%zu jobs on %d threads\n", jobs.size(), cores);
+    runJobs(jobs, options, applyStopFlags, cores, outDir);
+    return 0;
+  }
 
   index_t x = DIM_X, y = DIM_Y, z = DIM_Z;
 
   if (argc >= 4) {
-    x = atoi(argv[1]);
-    y = atoi(argv[2]);
-    z = atoi(argv[3]);
+    long lx = atol(argv[1]), ly = atol(argv[2]), lz = atol(argv[3]);
+    if (!Reactor::validDimensions(lx, ly, lz)) {
+      fprintf(stderr, "bad dimensions %ld %ld %ld (at most %d per side, %ld cells)\n",
+        lx, ly, lz, MAX_REACTOR_DIMENSION, (long)MAX_REACTOR_VOLUME);
+      return 1;
+    }
+    x = lx;
+    y = ly;
+    z = lz;
   }
 
   FuelType optimizeFuel = OPTIMIZE_FUEL;
@@ -294,38 +185,45 @@ int main(int argc, char ** argv)
     }
   }
 
-  fprintf(stderr, "%d %d %d %s ", x, y, z, fuelNameForFuelType(optimizeFuel).c_str());
+  options.fuel = optimizeFuel;
 
-  shortCoolerTypes = &shortCoolerTypes_passive;
+  // --portfolio: every fuel; --portfolio=A,B,...: those (and the one above)
+  if (flags.count("portfolio")) {
+    std::string list = flags["portfolio"];
+    if (list.empty()) {
+      for (int f = 2; f < static_cast<int>(FuelType::FUEL_TYPE_MAX); f++) {
+        options.portfolio.push_back(static_cast<FuelType>(f));
+      }
+    }
+    size_t from = 0;
+    while (from < list.size()) {
+      size_t comma = list.find(',', from);
+      std::string name = list.substr(from, comma == std::string::npos ? std::string::npos : comma - from);
+      FuelType f;
+      if (!fuelTypeForName(name, f) || static_cast<int>(f) < 2) {
+        fprintf(stderr, "unknown fuel %s\n", name.c_str());
+        return 1;
+      }
+      options.portfolio.push_back(f);
+      from = comma == std::string::npos ? list.size() : comma + 1;
+    }
+  }
+
+  fprintf(stderr, "%d %d %d %s ", x, y, z, fuelNameForFuelType(optimizeFuel).c_str());
 
   if (argc >= 6) {
     switch (atoi(argv[5])) {
       case 0:
-        shortCoolerTypes = &shortCoolerTypes_all;
-        break;
       case 1:
-        shortCoolerTypes = &shortCoolerTypes_passive;
-        break;
       case 2:
-        shortCoolerTypes = &shortCoolerTypes_active;
+        options.coolerRestrictions = atoi(argv[5]);
         break;
     }
   }
 
-  if (shortCoolerTypes == &shortCoolerTypes_all) {
-    fprintf(stderr, "whitelisted ");
-  }
-  else if (shortCoolerTypes == &shortCoolerTypes_passive) {
-    fprintf(stderr, "whitelisted ");
-  }
-  else if (shortCoolerTypes == &shortCoolerTypes_active) {
-    fprintf(stderr, "whitelisted ");
-  }
-  else {
-    fprintf(stderr, "??? ");
-  }
+  fprintf(stderr, "whitelisted ");
 
-  auto objective_fn = OBJECTIVE_FN;
+  auto objective_fn = objective_fn_efficiency;
 
   if (argc >= 7) {
     switch (atoi(argv[6])) {
@@ -341,6 +239,8 @@ int main(int argc, char ** argv)
     }
   }
 
+  options.objective = objective_fn;
+
   if (objective_fn == objective_fn_efficiency) {
     fprintf(stderr, "efficiency\n");
   }
@@ -354,8 +254,6 @@ int main(int argc, char ** argv)
     fprintf(stderr, "???\n");
   }
 
-  signal(SIGINT, catch_sigint);
-
   Reactor r(x, y, z);
 
   if (argc >= 8) {
@@ -370,53 +268,152 @@ int main(int argc, char ** argv)
 
   // r.setCell(DIM / 2, DIM / 2, DIM / 2, BlockType::reactorCell, CoolerType::air);
 
-  Reactor best_r = r;
+  options.threads = std::max(omp_get_num_procs() / 2, 1);
 
-  unsigned int num_threads = omp_get_num_procs() / 2;
+  // a resumed run takes its settings and dimensions from the checkpoint
+  std::string resumePath;
+  if (flags.count("resume")) {
+    resumePath = flags["resume"].empty() ? "out.ckpt" : flags["resume"];
+    if (!Search::checkpointSettings(resumePath, options, r)) {
+      return 1;
+    }
+    fprintf(stderr, "resuming %d %d %d %s run from %s\n", r.x(), r.y(), r.z(), fuelNameForFuelType(options.fuel).c_str(), resumePath.c_str());
+    options.checkpointPath = resumePath;
+  }
 
-  fprintf(stderr, "running %d parallel searches\n", num_threads);
-  omp_set_num_threads(num_threads);
+  if (flags.count("checkpoint")) {
+    options.checkpointPath = flags["checkpoint"].empty() ? "out.ckpt" : flags["checkpoint"];
+  }
+  if (flags.count("checkpoint-every")) {
+    options.checkpointEvery = atol(flags["checkpoint-every"].c_str());
+  }
 
-  std::vector<Reactor> reactors;
-  for(int i = 0; i < num_threads; i++)
-  {
-    reactors.push_back(r);
+  // stop policies; budgets default to something sensible for the size
+  options.stop = StopPolicy::forDimensions(r.x(), r.y(), r.z());
+  applyStopFlags(options.stop);
+
+  if (flags.count("time-limit")) {
+    options.timeLimit = atof(flags["time-limit"].c_str());
   }
 
-  for(int i = 0; i < 20000; i++)
-  {
-    if(!(i % 50)) fprintf(stderr, "step %u %f %u %f %f\n", i, objective_fn(reactors[0], optimizeFuel), best_r.totalCells(), best_r.effectivePowerGenerated(optimizeFuel), best_r.effectivePowerGenerated(optimizeFuel) / std::max(best_r.totalCells(), (int_fast32_t)1));
-    #pragma omp parallel for
-    for(int j = 0; j < num_threads; j++) {
-      step(reactors[j], i, optimizeFuel, objective_fn);
-    }
-    for(int j = 0; j < num_threads; j++) {
-      if(objective_fn(reactors[j], optimizeFuel) > objective_fn(best_r, optimizeFuel))
-      {
-        best_r = reactors[j];
-      }
-      //if(!(i % 250) || (!(i % 250) && objective_fn(reactors[j], optimizeFuel) < 1.)) reactors[j] = best_r;
-      if (rand() % 250 == 0) reactors[j] = best_r;
-    }
-    
+  // every thread keeps several copies of the reactor: for millions of
+  // cells, that rather than the cores is what limits the threads. A resumed
+  // run has as many as it was checkpointed with, whatever this machine has
+  if (flags.count("memory") && !resumePath.empty()) {
+    fprintf(stderr, "ignoring --memory: resuming with the checkpoint's %u threads\n", options.threads);
+  }
+  else if (flags.count("memory")) {
+    size_t budget = (size_t)(atof(flags["memory"].c_str()) * 1024 * 1024);
+    options.threads = Search::threadsWithinMemory(r.volume(), options, budget);
+    fprintf(stderr, "%.1f MB per reactor copy\n", Reactor::evaluatedBytes(r.volume()) / (1024. * 1024.));
+  }
+
+  // incumbents go out as they're found; kill -USR1 for the current one
+  IncumbentWriter incumbents("out.json", flags.count("stream") ? flags["stream"] : "");
+
+  auto incumbentInfo = [](Search & search, const char * why) {
+    Reactor & b = search.best();
+    Json::Value info;
+    info["Event"] = why;
+    info["Step"] = (Json::Int64)search.steps();
+    info["Seconds"] = search.monitor().elapsedSeconds();
+    info["Fuel"] = fuelNameForFuelType(search.options().fuel);
+    info["Objective"] = search.options().objective(b, search.options().fuel);
+    info["Metric"] = objectiveMetric(b, search.options().fuel, search.options().objective);
+    info["Gap"] = search.gap(b);
+    info["Cells"] = (Json::Int)b.totalCells();
+    info["EffectivePower"] = b.effectivePowerGenerated(search.options().fuel);
+    return info;
+  };
+
+  options.onNewBest = [&](Search & search, const char * why) {
+    incumbents.publish(search.best(), incumbentInfo(search, why));
+  };
+
+#ifdef SIGUSR1
+  signal(SIGUSR1, catch_sigusr1);
+  options.snapshotRequested = &got_sigusr1;
+#endif
+
+  fprintf(stderr, "running %d parallel searches\n", options.threads);
+
+  Search search(r, options);
+
+  if (!resumePath.empty() && !search.resume(resumePath)) {
+    return 1;
+  }
 
-    if(got_sigint) break;
+  if (search.symmetry()) {
+    fprintf(stderr, "symmetry %s: %zu of %d cells free\n", symmetryKindName(search.options().symmetry),
+      search.symmetry()->representatives().size(), (int)r.volume());
   }
 
+  fprintf(stderr, "bound: effective output %f, per cell %f, cells %f\n", search.bound().effectivePower, search.bound().efficiency, search.bound().cells);
+
+  search.run();
+  search.printStats();
+
+  Reactor & best_r = search.best();
 
-  printf("-------------------------\n");
+  // with --stream=- stdout is just the JSON lines
+  FILE * report = flags.count("stream") && flags["stream"] == "-" ? stderr : stdout;
 
-  printf("N %d\n", best_r.totalCells());
+  fprintf(report, "-------------------------\n");
 
-  printf("P %f\n", best_r.powerGenerated(FuelType::generic) / best_r.totalCells());
-  printf("H %f\n", best_r.heatGenerated(FuelType::generic) / best_r.totalCells());
-  printf("C %f\n", best_r.heatGenerated(FuelType::air));
+  fprintf(report, "N %lld\n", (long long)best_r.totalCells());
 
-  FuelType f = optimizeFuel;
-  printf("%s %f %f %f %f\n\n\n", fuelNameForFuelType(f).c_str(), best_r.powerGenerated(f), best_r.heatGenerated(f), best_r.effectivePowerGenerated(f), best_r.effectivePowerGenerated(f) / std::max(best_r.totalCells(), (int_fast32_t)1));
+  fprintf(report, "P %f\n", best_r.powerGenerated(FuelType::generic) / best_r.totalCells());
+  fprintf(report, "H %f\n", best_r.heatGenerated(FuelType::generic) / best_r.totalCells());
+  fprintf(report, "C %f\n", best_r.heatGenerated(FuelType::air));
+
+  FuelType f = search.options().fuel;
+  fprintf(report, "%s %f %f %f %f\n\n\n", fuelNameForFuelType(f).c_str(), best_r.powerGenerated(f), best_r.heatGenerated(f), best_r.effectivePowerGenerated(f), best_r.effectivePowerGenerated(f) / std::max(best_r.totalCells(), (largecount_t)1));
   std::string desc = best_r.describe();
-  printf("%s\n", desc.c_str());
+  fprintf(report, "%s\n", desc.c_str());
+
+  incumbents.publish(best_r, incumbentInfo(search, "final"));
+  incumbents.close();
+
+  best_r.toHeatmapJsonFile("out.heatmap.json");
+  best_r.toHeatmapBinaryFile("out.heatmap.bin");
+
+  if (search.options().pareto) {
+    auto front = search.archive().front();
+    fprintf(report, "\npareto front: %zu designs\neffectiveOutput\tperCell\tcells\tcoolers\n", front.size());
+    for (auto & member : front) {
+      fprintf(report, "%f\t%f\t%d\t%d\n", member.first.effectivePower, member.first.efficiency, (int)member.first.cells, (int)member.first.coolers);
+    }
+    search.archive().toJsonFile("out.pareto.json");
+  }
 
-  best_r.toJsonFile("out.json");
+  // diverse alternatives, out.top.<rank>.json each
+  if (search.options().topK > 0) {
+    auto top = search.topK().members();
+    fprintf(report, "\ntop %zu designs at least %d cells apart\nrank\tobjective\tcells\teffectiveOutput\tperCell\tdistanceToFirst\n", top.size(), search.topK().minDistance());
+    Bitplanes first;
+    for (size_t k = 0; k < top.size(); k++) {
+      Reactor & tr = top[k].second;
+      Bitplanes planes(tr);
+      if (k == 0) {
+        first = planes;
+      }
+      fprintf(report, "%zu\t%f\t%d\t%f\t%f\t%d\n", k + 1, top[k].first, (int)tr.totalCells(), tr.effectivePowerGenerated(f),
+        tr.effectivePowerGenerated(f) / std::max(tr.totalCells(), (largecount_t)1), Bitplanes::distance(planes, first));
+      tr.toJsonFile("out.top." + std::to_string(k + 1) + ".json");
+    }
+  }
+
+  // the portfolio's other designs, out.<fuel>.json each
+  const std::vector<FuelType> & portfolio = search.options().portfolio;
+  if (!portfolio.empty()) {
+    fprintf(report, "\nfuel\tcells\teffectiveOutput\tperCell\tobjective\n");
+  }
+  for (size_t k = 0; k < portfolio.size(); k++) {
+    Reactor & pr = search.portfolioBest(k);
+    FuelType pf = portfolio[k];
+    fprintf(report, "%s\t%d\t%f\t%f\t%f\n", fuelNameForFuelType(pf).c_str(), (int)pr.totalCells(), pr.effectivePowerGenerated(pf),
+      pr.effectivePowerGenerated(pf) / std::max(pr.totalCells(), (largecount_t)1), search.portfolioScore(k));
+    pr.toJsonFile("out." + fuelNameForFuelType(pf) + ".json");
+  }
   return 0;
 }
@@ -0,0 +1,213 @@
+/** Checks checkpoints:
+  *
+  * - that values, strings and reactors (every block and cooler type) come
+  *   back from a file as they were put in, and that a truncated, corrupted
+  *   or foreign file, or one claiming absurd sizes, is refused
+  * - that a checkpointed search resumes exactly where it stopped: same best
+  *   design, step and thread reactors as a run that was never interrupted.
+  *   The resuming side starts from a different number of threads than the
+  *   checkpoint was taken with (as on a machine with another core count, or
+  *   after --memory capped the first run), and has to take the
+  *   checkpoint's.
+  *
+  * `make test` runs it.
+  */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Search.h"
+
+static int checks = 0;
+static int failures = 0;
+
+static void expect(bool ok, const char * what, const char * check) {
+  checks++;
+  if (!ok) {
+    failures++;
+    fprintf(stderr, "FAIL %s: %s\n", what, check);
+  }
+}
+
+template <typename T>
+static std::vector<uint64_t> members(const std::vector<std::pair<T, Reactor> > & archive) {
+  std::vector<uint64_t> ret;
+  for (const auto & member : archive) {
+    ret.push_back(member.second.contentHash());
+  }
+  return ret;
+}
+
+/** Replace `path` with `bytes`. */
+static void overwrite(const std::string & path, const std::vector<char> & bytes) {
+  std::ofstream out(path, std::ios_base::binary | std::ios_base::trunc);
+  out.write(bytes.data(), bytes.size());
+}
+
+static void roundTrip() {
+  const char * what = "round trip";
+  const std::string path = "test-checkpoint-round-trip.ckpt";
+  std::mt19937_64 g(35);
+
+  // every cell code, in random designs; long runs (an empty reactor) and
+  // none (a random string) for the compression
+  std::vector<Reactor> reactors = { Reactor(1, 1, 1), Reactor(20, 20, 20) };
+  for (index_t d : { 3, 9 }) {
+    Reactor r(d, d + 1, d + 2);
+    std::uniform_int_distribution<int> code(0, 2 + static_cast<int>(CoolerType::COOLER_TYPE_MAX) - 1);
+    for (vector_offset_t n = 0; n < r.volume(); n++) {
+      int k = code(g);
+      r.setCellCode(n, k <= 2 ? k : k + 1);
+    }
+    reactors.push_back(r);
+  }
+  std::string noise(3000, 0);
+  for (char & c : noise) {
+    c = static_cast<char>(g());
+  }
+  const std::vector<std::string> strings = { "", "a", std::string(1000, 'x') + "y", noise };
+
+  CheckpointWriter out;
+  out.put<uint64_t>(0x0123456789abcdefULL);
+  out.put<int32_t>(-35);
+  out.put<float>(NAN);
+  out.put<double>(-0.25);
+  for (const std::string & str : strings) {
+    out.putString(str);
+  }
+  for (Reactor & r : reactors) {
+    out.putReactor(r);
+  }
+  expect(out.writeFile(path), what, "written");
+
+  CheckpointReader in(path);
+  uint64_t u;
+  int32_t i;
+  float f;
+  double d;
+  expect(in.ok() && in.get(u) && u == 0x0123456789abcdefULL, what, "uint64");
+  expect(in.get(i) && i == -35, what, "int32");
+  expect(in.get(f) && std::isnan(f), what, "float");
+  expect(in.get(d) && d == -0.25, what, "double");
+  for (const std::string & str : strings) {
+    std::string back;
+    expect(in.getString(back) && back == str, what, "string");
+  }
+  for (Reactor & r : reactors) {
+    Reactor back;
+    expect(in.getReactor(back) && back == r && back.contentHash() == r.contentHash(), what, "reactor");
+  }
+  expect(!in.get(u) && !in.ok(), what, "nothing past the end");
+
+  std::vector<char> file;
+  {
+    std::ifstream raw(path, std::ios_base::binary);
+    file.assign(std::istreambuf_iterator<char>(raw), std::istreambuf_iterator<char>());
+  }
+
+  // (the reader complains on stderr about each of these)
+  std::vector<char> corrupt(file);
+  corrupt[corrupt.size() / 2] ^= 0x10;
+  overwrite(path, corrupt);
+  expect(!CheckpointReader(path).ok(), what, "corrupted file refused");
+
+  overwrite(path, std::vector<char>(file.begin(), file.begin() + file.size() / 2));
+  expect(!CheckpointReader(path).ok(), what, "truncated file refused");
+
+  std::vector<char> foreign(file);
+  foreign[0] = 'X';
+  overwrite(path, foreign);
+  expect(!CheckpointReader(path).ok(), what, "foreign file refused");
+
+  // sizes and counts from the file are checked before allocating for them
+  std::vector<char> huge(file);
+  const uint64_t claimed = UINT64_C(1) << 60;
+  memcpy(&huge[8], &claimed, sizeof(claimed));
+  overwrite(path, huge);
+  expect(!CheckpointReader(path).ok(), what, "absurd size refused");
+
+  CheckpointWriter members;
+  members.put<uint64_t>(claimed);
+  members.writeFile(path);
+  CheckpointReader count(path);
+  ParetoArchive archive;
+  expect(count.ok() && !archive.load(count), what, "absurd archive size refused");
+
+  remove(path.c_str());
+  expect(!CheckpointReader(path).ok(), what, "missing file refused");
+}
+
+static SearchOptions options(unsigned int threads, long steps) {
+  SearchOptions ret;
+  ret.threads = threads;
+  ret.seed = 7;
+  ret.logEvery = 0;
+  ret.stop.maxSteps = steps;
+  ret.stop.minSteps = steps;
+  return ret;
+}
+
+static void resume(const char * what, unsigned int threads, unsigned int resumingThreads, SearchOptions base) {
+  const std::string path = "test-checkpoint.ckpt";
+  const long first = 120, total = 300;
+  Reactor initial(5, 4, 3);
+
+  SearchOptions o = options(threads, total);
+  o.pareto = base.pareto;
+  o.topK = base.topK;
+  o.surrogate = base.surrogate;
+  Search whole(initial, o);
+  whole.run();
+
+  o.stop.maxSteps = o.stop.minSteps = first;
+  o.checkpointPath = path;
+  Search interrupted(initial, o);
+  interrupted.run();
+
+  // what main does: this machine's thread count, then the checkpoint's
+  SearchOptions resumed = options(resumingThreads, total);
+  Reactor best;
+  bool read = Search::checkpointSettings(path, resumed, best);
+  expect(read, what, "settings read");
+  if (!read) {
+    return;
+  }
+  expect(resumed.threads == threads, what, "checkpointed thread count");
+  resumed.stop = options(threads, total).stop;
+
+  Search continued(best, resumed);
+  bool ok = continued.resume(path);
+  expect(ok, what, "resumed");
+  if (ok) {
+    continued.run();
+    expect(continued.steps() == whole.steps(), what, "steps");
+    expect(continued.best().contentHash() == whole.best().contentHash(), what, "best design");
+    expect(members(continued.archive().front()) == members(whole.archive().front()), what, "Pareto archive");
+    expect(continued.topK().size() == whole.topK().size(), what, "top designs");
+  }
+  remove(path.c_str());
+}
+
+int main() {
+  roundTrip();
+
+  SearchOptions plain;
+  resume("resume with fewer threads than checkpointed", 3, 1, plain);
+  resume("resume with more threads than checkpointed", 2, 8, plain);
+  resume("resume with as many threads as checkpointed", 4, 4, plain);
+
+  SearchOptions archives;
+  archives.pareto = true;
+  archives.topK = 5;
+  archives.surrogate = true;
+  resume("resume with archives and surrogates on another thread count", 3, 6, archives);
+
+  printf("%d checks, %d failures\n", checks, failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+/** Checks the shortcuts Reactor::_evaluate takes against scoring every cell
+  * (_evaluateCells(0)), cell by cell:
+  *
+  * - the octant evaluation of mirror symmetric designs, for every set of
+  *   mirror axes, on odd and even sides and axes of length 1
+  * - the sparse evaluation, at occupancies from empty to full, and again
+  *   after queries and edits, after more edits than it keeps track of, and
+  *   after an approximate evaluation (when it only clears what the previous
+  *   evaluation left); activity caches included
+  *
+  * `make test` runs it.
+  */
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Reactor.h"
+
+struct EvaluationTest {
+  int checks = 0;
+  int failures = 0;
+
+  void expect(bool ok, const char * what, Reactor & r) {
+    checks++;
+    if (!ok) {
+      failures++;
+      fprintf(stderr, "FAIL %s, %dx%dx%d:\n%s", what, r.x(), r.y(), r.z(), r.describe().c_str());
+    }
+  }
+
+  /** Whether the activity caches hold the same as `b`'s. */
+  static bool sameCaches(const Reactor & a, const Reactor & b) {
+    return a._cellActiveCache == b._cellActiveCache && a._cellModeratorAdjacencyCache == b._cellModeratorAdjacencyCache;
+  }
+
+  /** Reference: every cell scored. */
+  static Reactor full(const Reactor & r) {
+    Reactor ret(r);
+    ret._evaluateCells(0);
+    return ret;
+  }
+
+  /** A random design: each cell air with probability `air`, otherwise a
+    * reactor cell, moderator or any cooler; mirrored in the axes of
+    * `mirrors` (bit i for axis i).
+    */
+  template <typename Engine>
+  static Reactor design(index_t x, index_t y, index_t z, double air, int mirrors, Engine & g) {
+    Reactor r(x, y, z);
+    std::uniform_real_distribution<double> u(0, 1);
+    std::uniform_int_distribution<int> code(1, 2 + static_cast<int>(CoolerType::COOLER_TYPE_MAX) - 1);
+    std::vector<uint8_t> codes(r.volume());
+    for (uint8_t & c : codes) {
+      int k = code(g);
+      // 1: reactor cell, 2: moderator, 3 + t: cooler t (t > 0)
+      c = u(g) < air ? 0 : k <= 2 ? k : k + 1;
+    }
+
+    for (index_t i = 0; i < x; i++) {
+      for (index_t j = 0; j < y; j++) {
+        for (index_t k = 0; k < z; k++) {
+          index_t si = mirrors & 1 ? std::min(i, x - 1 - i) : i;
+          index_t sj = mirrors & 2 ? std::min(j, y - 1 - j) : j;
+          index_t sk = mirrors & 4 ? std::min(k, z - 1 - k) : k;
+          r.setCellCode(r.cellIndex(i, j, k), codes[((largecount_t)si * y + sj) * z + sk]);
+        }
+      }
+    }
+    return r;
+  }
+
+  template <typename Engine>
+  void symmetric(index_t x, index_t y, index_t z, Engine & g) {
+    for (int mirrors = 1; mirrors < 8; mirrors++) {
+      for (double air : { 0.0, 0.3, 0.7 }) {
+        Reactor r = design(x, y, z, air, mirrors, g);
+        int found = r._mirrorAxes();
+        expect((found & mirrors) == mirrors, "mirror axes of a symmetric design", r);
+
+        Reactor octant(r);
+        octant._evaluateCells(found);
+        expect(octant._sameEvaluation(full(r)), "symmetric evaluation", r);
+      }
+    }
+  }
+
+  template <typename Engine>
+  void sparse(index_t x, index_t y, index_t z, Engine & g) {
+    std::uniform_int_distribution<index_t> ux(0, x - 1), uy(0, y - 1), uz(0, z - 1);
+    for (double air : { 1.0, 0.99, 0.9, 0.5, 0.0 }) {
+      Reactor r = design(x, y, z, air, 0, g);
+      r._evaluateSparse();
+      expect(r._sameEvaluation(full(r)), "sparse evaluation", r);
+
+      // again, clearing only the previous blocks' contributions, and the
+      // activity cached by queries about empty cells since
+      Reactor edited(r);
+      for (int q = 0; q < 20; q++) {
+        edited.coolerTypeActiveAt(ux(g), uy(g), uz(g), static_cast<CoolerType>(1 + q % (static_cast<int>(CoolerType::COOLER_TYPE_MAX) - 1)));
+      }
+      // (one by one, and as a batch)
+      std::vector<CellChange> batch;
+      for (int e = 0; e < 10; e++) {
+        index_t i = ux(g), j = uy(g), k = uz(g);
+        BlockType block = e % 2 ? BlockType::air : BlockType::cooler;
+        if (e < 5) {
+          edited.setCell(i, j, k, block, CoolerType::water);
+        }
+        else {
+          batch.push_back({ i, j, k, block, CoolerType::water });
+        }
+      }
+      std::vector<coord_t> applied;
+      edited.applyCells(batch, applied);
+      edited._evaluateSparse();
+      expect(edited._sameEvaluation(full(edited)), "sparse evaluation after edits", edited);
+      expect(sameCaches(edited, full(edited)), "activity caches after edits", edited);
+
+      // with more cells filled and emptied again than _filled holds
+      Reactor churned(r);
+      for (largecount_t e = 0; e <= churned.volume() / SPARSE_EVALUATION_OCCUPANCY + 1; e++) {
+        index_t i = ux(g), j = uy(g), k = uz(g);
+        if (churned.blockTypeAt(i, j, k) == BlockType::air) {
+          churned.setCell(i, j, k, BlockType::moderator, CoolerType::air);
+          churned.setCell(i, j, k, BlockType::air, CoolerType::air);
+        }
+      }
+      churned.setCell(ux(g), uy(g), uz(g), BlockType::reactorCell, CoolerType::air);
+      churned._evaluateSparse();
+      expect(churned._sameEvaluation(full(churned)), "sparse evaluation after many edits", churned);
+      expect(sameCaches(churned, full(churned)), "activity caches after many edits", churned);
+
+      // and after an approximate evaluation has written outside the lists
+      Reactor approximate(r);
+      std::vector<coord_t> changed = { { ux(g), uy(g), uz(g) } };
+      approximate.setCell(UNPACK(changed[0]), BlockType::reactorCell, CoolerType::air);
+      approximate.evaluateApproximate(changed);
+      approximate._dirty = true;
+      approximate._evaluateSparse();
+      expect(approximate._sameEvaluation(full(approximate)), "sparse evaluation after an approximate one", approximate);
+
+      // and whichever way _evaluate picks for this occupancy
+      Reactor picked(edited);
+      picked.invalidate();
+      picked._evaluate();
+      expect(picked._sameEvaluation(full(edited)), "evaluation picked by occupancy", picked);
+    }
+  }
+};
+
+int main() {
+  std::mt19937_64 g(1);
+  EvaluationTest t;
+
+  // odd and even sides, and axes of length 1
+  const index_t dimensions[][3] = {
+    {1, 1, 1}, {1, 1, 6}, {1, 4, 5}, {2, 3, 1}, {3, 3, 3}, {4, 4, 4},
+    {5, 5, 5}, {6, 5, 4}, {7, 1, 7}, {7, 7, 7}, {8, 6, 2}, {9, 9, 9},
+  };
+
+  for (const auto & d : dimensions) {
+    for (int rep = 0; rep < 4; rep++) {
+      t.symmetric(d[0], d[1], d[2], g);
+      t.sparse(d[0], d[1], d[2], g);
+    }
+  }
+
+  // the designs above hold every kind of cell, each cooler included
+  Reactor every = EvaluationTest::design(9, 9, 9, 0.0, 0, g);
+  std::vector<bool> seen(3 + static_cast<int>(CoolerType::COOLER_TYPE_MAX));
+  for (vector_offset_t n = 0; n < every.volume(); n++) {
+    seen[every.cellCode(n)] = true;
+  }
+  seen[0] = seen[3] = true;
+  t.expect(std::find(seen.begin(), seen.end(), false) == seen.end(), "every block and cooler type in random designs", every);
+
+  printf("%d checks, %d failures\n", t.checks, t.failures);
+  return t.failures ? 1 : 0;
+}
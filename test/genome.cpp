@@ -0,0 +1,80 @@
+/** Checks that stored designs stay small and that both of Genome's
+  * representations (inline planes for small designs, shared chunks for
+  * large ones) give back the design they were made from, and the same
+  * distances as encoding it anew. `make test` runs it.
+  */
+
+#include <cstdio>
+#include <random>
+
+#include "Diversity.h"
+
+static int checks = 0;
+static int failures = 0;
+
+static void expect(bool ok, const char * what, const Reactor & r) {
+  checks++;
+  if (!ok) {
+    failures++;
+    fprintf(stderr, "FAIL %s, %dx%dx%d\n", what, r.x(), r.y(), r.z());
+  }
+}
+
+/** A random design, each cell air with probability `air`. */
+template <typename Engine>
+static Reactor design(index_t x, index_t y, index_t z, double air, Engine & g) {
+  Reactor r(x, y, z);
+  std::uniform_real_distribution<double> u(0, 1);
+  // 1: reactor cell, 2: moderator, 3 + t: cooler t (t > 0)
+  std::uniform_int_distribution<int> code(1, 2 + static_cast<int>(CoolerType::COOLER_TYPE_MAX) - 1);
+  for (vector_offset_t n = 0; n < r.volume(); n++) {
+    int k = code(g);
+    r.setCellCode(n, u(g) < air ? 0 : k <= 2 ? k : k + 1);
+  }
+  return r;
+}
+
+template <typename Engine>
+static void stored(index_t x, index_t y, index_t z, Engine & g) {
+  for (double air : { 1.0, 0.9, 0.3 }) {
+    Reactor r = design(x, y, z, air, g);
+    Genome genome(r);
+    expect(genome.chunked() == (r.volume() > Genome::INLINE_CELLS), "representation", r);
+
+    bool same = true;
+    for (vector_offset_t n = 0; n < r.volume(); n++) {
+      same = same && genome.codeAt(n) == r.cellCode(n);
+    }
+    expect(same, "codes", r);
+    Reactor back = genome.reactor();
+    expect(back.contentHash() == r.contentHash() && genome.contentHash() == r.contentHash(), "design", r);
+    expect(Genome(back) == genome, "equality", r);
+
+    Reactor other = design(x, y, z, air, g);
+    Bitplanes planes(r);
+    expect(Bitplanes::distance(planes, genome) == 0, "distance to itself", r);
+    expect(Bitplanes::distance(planes, Genome(other)) == Bitplanes::distance(planes, Bitplanes(other)), "distance", r);
+  }
+}
+
+int main() {
+  std::mt19937_64 g(45);
+
+  // a 9x9x9 takes no more than its codes packed back to back, under 500
+  // bytes
+  Reactor small = design(9, 9, 9, 0.3, g);
+  expect(Genome(small).bytes() == (5 * 729 + 63) / 64 * 8, "size of a 9x9x9", small);
+  expect(Genome(small).bytes() < 500, "size of a 9x9x9", small);
+
+  // inline: odd lengths, planes that don't end on a word, and INLINE_CELLS
+  // itself; chunked: just past it, and a last chunk that isn't full
+  stored(1, 1, 1, g);
+  stored(3, 3, 3, g);
+  stored(9, 9, 9, g);
+  stored(16, 16, 8, g);
+  stored(16, 16, 9, g);
+  stored(20, 17, 9, g);
+
+  printf("%d checks, %d failures\n", checks, failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+/** Checks WeightedReservoir: items go in and come back out unchanged (the
+  * loser of an offer handed back to the caller), are kept in proportion to
+  * their weights, and weights that aren't positive only win when nothing
+  * else is offered. `make test` runs it.
+  */
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Reservoir.h"
+
+static int checks = 0;
+static int failures = 0;
+
+static void expect(bool ok, const char * what) {
+  checks++;
+  if (!ok) {
+    failures++;
+    fprintf(stderr, "FAIL %s\n", what);
+  }
+}
+
+int main() {
+  std::mt19937_64 g(26);
+
+  // what goes in comes out, and an offer that wins hands back the previous
+  // winner
+  {
+    WeightedReservoir<std::string> r;
+    expect(r.empty(), "empty at first");
+    std::string item = "first";
+    expect(r.offer(item, 1, g), "first offer wins");
+    expect(!r.empty() && r.item() == "first", "first item kept");
+    int won = 0;
+    for (int i = 0; i < 100; i++) {
+      item = "item " + std::to_string(i);
+      std::string offered = item;
+      std::string before = r.item();
+      if (r.offer(item, 1, g)) {
+        won++;
+        expect(r.item() == offered && item == before, "winner swapped in, previous one handed back");
+      }
+      else {
+        expect(r.item() == before && item == offered, "loser left alone");
+      }
+    }
+    expect(won > 0 && won < 100, "later offers win sometimes");
+
+    r.reset();
+    expect(r.empty(), "empty after reset");
+    item = "after reset";
+    expect(r.offer(item, 1e-9, g) && r.item() == "after reset", "first offer after reset wins");
+  }
+
+  // kept with probability w / sum(w)
+  {
+    const std::vector<double> weights = { 1, 2, 3, 4, 0.5 };
+    const double total = 10.5;
+    const int trials = 100000;
+    std::vector<int> kept(weights.size());
+    WeightedReservoir<int> r;
+    for (int t = 0; t < trials; t++) {
+      r.reset();
+      for (int i = 0; i < (int)weights.size(); i++) {
+        int item = i;
+        r.offer(item, weights[i], g);
+      }
+      kept[r.item()]++;
+    }
+    for (size_t i = 0; i < weights.size(); i++) {
+      double p = weights[i] / total;
+      // five standard deviations
+      expect(std::fabs(kept[i] - p * trials) < 5 * std::sqrt(trials * p * (1 - p)), "kept in proportion to weight");
+    }
+  }
+
+  // weights that aren't positive
+  {
+    WeightedReservoir<int> r;
+    int item = 1;
+    r.offer(item, 0, g);
+    item = 2;
+    r.offer(item, -1, g);
+    item = 3;
+    r.offer(item, NAN, g);
+    expect(!r.empty() && r.item() == 1 && std::isinf(r.key()), "without a positive weight, the first item is kept");
+    item = 4;
+    expect(r.offer(item, 1e-6, g) && r.item() == 4, "any positive weight wins over them");
+    item = 5;
+    expect(!r.offer(item, 0, g) && r.item() == 4, "and keeps winning");
+  }
+
+  printf("%d checks, %d failures\n", checks, failures);
+  return failures ? 1 : 0;
+}
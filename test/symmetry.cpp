@@ -0,0 +1,142 @@
+/** Checks SymmetryGroup and the canonical form: that a design's mirror
+  * images and rotations, built cell by cell, all get its canonicalHash and
+  * map back to the same canonical image, that other designs don't share it,
+  * and that orbits, representatives and symmetrize agree with the
+  * elements. `make test` runs it.
+  */
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Symmetry.h"
+
+static int checks = 0;
+static int failures = 0;
+
+static void expect(bool ok, const char * what, const Reactor & r) {
+  checks++;
+  if (!ok) {
+    failures++;
+    fprintf(stderr, "FAIL %s, %dx%dx%d\n", what, r.x(), r.y(), r.z());
+  }
+}
+
+/** A random design, each cell air with probability `air`. */
+template <typename Engine>
+static Reactor design(index_t x, index_t y, index_t z, double air, Engine & g) {
+  Reactor r(x, y, z);
+  std::uniform_real_distribution<double> u(0, 1);
+  // 1: reactor cell, 2: moderator, 3 + t: cooler t (t > 0)
+  std::uniform_int_distribution<int> code(1, 2 + static_cast<int>(CoolerType::COOLER_TYPE_MAX) - 1);
+  for (vector_offset_t n = 0; n < r.volume(); n++) {
+    int k = code(g);
+    r.setCellCode(n, u(g) < air ? 0 : k <= 2 ? k : k + 1);
+  }
+  return r;
+}
+
+/** Image of r under element g: cell n is cell element(g)[n] of r. */
+static Reactor image(const Reactor & r, const SymmetryGroup::Element & e) {
+  Reactor ret(r.x(), r.y(), r.z());
+  for (vector_offset_t n = 0; n < r.volume(); n++) {
+    ret.setCellCode(n, r.cellCode(e[n]));
+  }
+  return ret;
+}
+
+template <typename Engine>
+static void canonical(index_t x, index_t y, index_t z, size_t elements, Engine & g) {
+  const SymmetryGroup & group = SymmetryGroup::forDimensions(x, y, z);
+  Reactor probe(x, y, z);
+  expect(group.size() == elements, "group size", probe);
+
+  // every element is a permutation, and walking one gives its images
+  bool permutations = true, walks = true;
+  for (size_t e = 0; e < group.size(); e++) {
+    std::vector<bool> hit(probe.volume());
+    SymmetryGroup::Walk w(group.element(e));
+    for (uint32_t n = 0; n < probe.volume(); n++, w.next()) {
+      uint32_t m = group.element(e)[n];
+      permutations = permutations && m < probe.volume() && !hit[m];
+      walks = walks && *w == m;
+      if (m < probe.volume()) {
+        hit[m] = true;
+      }
+    }
+  }
+  expect(permutations, "elements are permutations", probe);
+  expect(walks, "walks", probe);
+
+  // orbits partition the cells, and representatives are their smallest
+  size_t covered = 0;
+  bool orbits = true;
+  for (uint32_t rep : group.representatives()) {
+    SymmetryGroup::Orbit orbit = group.orbit(rep);
+    covered += orbit.size();
+    orbits = orbits && orbit[0] == rep && std::is_sorted(orbit.begin(), orbit.end());
+    for (uint32_t m : orbit) {
+      orbits = orbits && group.representative(m) == rep;
+    }
+  }
+  expect(orbits && covered == (size_t)probe.volume(), "orbits", probe);
+
+  for (double air : { 1.0, 0.8, 0.3 }) {
+    Reactor r = design(x, y, z, air, g);
+    const size_t hash = canonicalHash(r);
+    Reactor form = image(r, group.element(canonicalElement(r)));
+
+    bool same = true, smallest = true, invariant = true;
+    for (size_t e = 0; e < group.size(); e++) {
+      Reactor i = image(r, group.element(e));
+      same = same && canonicalHash(i) == hash && image(i, group.element(canonicalElement(i))) == form;
+      invariant = invariant && i == r;
+      for (vector_offset_t n = 0; n < r.volume(); n++) {
+        if (i.cellCode(n) != form.cellCode(n)) {
+          smallest = smallest && form.cellCode(n) < i.cellCode(n);
+          break;
+        }
+      }
+    }
+    expect(same, "every image has the same canonical form and hash", r);
+    expect(smallest, "the canonical form is the smallest image", r);
+
+    // (an empty design has no other to tell apart from)
+    if (air < 1) {
+      Reactor other(r);
+      other.setCellCode(0, r.cellCode(0) == 1 ? 2 : 1);
+      expect(canonicalHash(other) != hash, "another design hashes differently", r);
+    }
+
+    Reactor symmetric(r);
+    group.symmetrize(symmetric);
+    expect(group.isSymmetric(symmetric), "symmetrized design is symmetric", r);
+    expect(group.isSymmetric(r) == invariant, "symmetric designs are their own images", r);
+  }
+}
+
+int main() {
+  std::mt19937_64 g(41);
+
+  // all dimensions different, two equal, a cube; axes of length 1
+  canonical(3, 4, 5, 8, g);
+  canonical(4, 4, 3, 16, g);
+  canonical(3, 5, 3, 16, g);
+  canonical(4, 4, 4, 48, g);
+  canonical(5, 5, 5, 48, g);
+  canonical(1, 4, 5, 4, g);
+  canonical(1, 1, 6, 2, g);
+  canonical(1, 1, 1, 1, g);
+  canonical(6, 6, 1, 8, g);
+
+  // only what's asked for
+  Reactor probe(4, 4, 4);
+  expect(SymmetryGroup::forDimensions(4, 4, 4, SymmetryGroup::Kind::none).size() == 1, "no symmetry", probe);
+  expect(SymmetryGroup::forDimensions(4, 4, 4, SymmetryGroup::Kind::mirrorX).size() == 2, "mirrored in x", probe);
+  expect(SymmetryGroup::forDimensions(4, 4, 4, SymmetryGroup::Kind::mirrorXYZ).size() == 8, "mirrored in every axis", probe);
+  expect(SymmetryGroup::forDimensions(4, 4, 4, SymmetryGroup::Kind::mirrorXYZ).representatives().size() == 8, "octant", probe);
+
+  printf("%d checks, %d failures\n", checks, failures);
+  return failures ? 1 : 0;
+}